@@ -1,4 +1,63 @@
 //
 // Created by fredr on 3/14/2025.
 //
+// ActuatorCommandExecutor.h
 #pragma once
+#include <Arduino.h>
+#include "link/LinkCommands.h"
+#include "link/LinkProtocol.h"
+
+namespace ActuatorsController {
+
+// Sends actuator commands to the Mega as COMMAND frames tagged with a sequence number
+// and tracks the ACK/NAK the Mega returns for each of them.  On an RS-485 bus each Mega
+// has its own executor, addressed by node.
+class ActuatorCommandExecutor {
+public:
+    // Delivery state of a command.
+    enum class CommandState : uint8_t { UNKNOWN, PENDING, ACKED, NAKED, TIMED_OUT };
+
+    explicit ActuatorCommandExecutor(Stream &link, uint8_t node = LINK_FIRST_NODE);
+    // Sends a command for an actuator number (or ALL_ACTUATORS) to the Mega and returns the
+    // sequence number it was tagged with, or 0 if the frame could not be written.
+    uint16_t send(Opcode opcode, uint8_t actuator);
+    // Records the Mega's acknowledgement; status OK is an ACK, anything else a NAK.
+    void handleAcknowledgement(uint16_t sequence, CommandStatus status);
+    // Marks commands that were not acknowledged within ACK_TIMEOUT as timed out.
+    void expirePending();
+    // State of one of the most recently sent commands.
+    CommandState getState(uint16_t sequence) const;
+    // NAK reason (or "OK") of a recently acknowledged command; empty while it is pending.
+    const char *getStatus(uint16_t sequence) const;
+    static const char *stateName(CommandState state);
+
+    uint16_t getAckedCount() const { return ackedCount; }
+    uint16_t getNakedCount() const { return nakedCount; }
+    uint16_t getTimeoutCount() const { return timeoutCount; }
+    uint8_t getNode() const { return node; }
+
+private:
+    // Number of recent commands whose state is remembered.
+    static const uint8_t HISTORY_SIZE = 8;
+    static const unsigned long ACK_TIMEOUT = 1000; // ms
+
+    struct SentCommand {
+        uint16_t sequence;
+        unsigned long sentAt;
+        CommandState state;
+        CommandStatus status;
+    };
+
+    Stream &link;
+    uint8_t node;
+    uint16_t nextSequence;
+    SentCommand history[HISTORY_SIZE];
+    uint16_t ackedCount;
+    uint16_t nakedCount;
+    uint16_t timeoutCount;
+
+    SentCommand *find(uint16_t sequence);
+    const SentCommand *find(uint16_t sequence) const;
+};
+
+} // namespace ActuatorsController
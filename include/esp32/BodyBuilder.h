@@ -4,6 +4,7 @@
 #pragma once
 #include <Arduino.h>
 #include "StatusReportProcessor.h"
+#include "PageSink.h"
 
 using namespace ActuatorsController;
 
@@ -29,12 +30,13 @@ public:
     virtual String buildBody();
     // Overloaded buildBody accepts StatusReportData.
     virtual String buildBody(const StatusReportData &statusReport);
+    // Writes the body for StatusReportData into out; buildBody(statusReport) returns the same.
+    virtual void writeBody(PageSink &out, const StatusReportData &statusReport);
 
 protected:
     // Holds the dynamic content that will be wrapped in the body.
     String bodyContent;
-    // New overload for buildControlButtons that accepts StatusReportData,
-    // returning control buttons built from live data.
-    String buildControlButtons(const StatusReportData &statusReport);
+    // Writes the control buttons built from live StatusReportData.
+    void writeControlButtons(PageSink &out, const StatusReportData &statusReport);
 
     };
@@ -0,0 +1,139 @@
+//
+// EspLog.h
+// Description: Leveled, per-module logging for the ESP32 that never blocks the caller.
+//
+// ESPLOG(STATUS, WARN, "Actuator index out of range: %u", idx) checks the module's level
+// at compile time; a message above it compiles to nothing, arguments included.  An enabled
+// message is stored as a binary record (format pointer, millis() and raw arguments) in a
+// lock-free ring, and only turned into text when EspLog::drain() writes it to the console.
+//
+// Because formatting is deferred, the format and any %s argument must outlive the record:
+// string literals, or strings from tables like inputMappings.  Passing a String does not
+// compile.  Conversions understood are %d %i %u %x %X %c %s and %%.
+//
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+#include "esp32Config.h"
+
+namespace ActuatorsController {
+
+enum class LogLevel : uint8_t { OFF, ERROR, WARN, INFO, DEBUG };
+
+enum class LogModule : uint8_t {
+    LINK,    // frames, sequence gaps and the heartbeat
+    STATUS,  // STATUS frames and the report
+    COMMAND, // commands sent and their acknowledgements
+    RATE,    // baud rate negotiation
+    BUS,     // RS-485 polling
+    COUNT
+};
+
+constexpr uint8_t logModuleLevel(LogModule module) {
+    return module == LogModule::LINK      ? LOG_LEVEL_LINK
+           : module == LogModule::STATUS  ? LOG_LEVEL_STATUS
+           : module == LogModule::COMMAND ? LOG_LEVEL_COMMAND
+           : module == LogModule::RATE    ? LOG_LEVEL_RATE
+           : module == LogModule::BUS     ? LOG_LEVEL_BUS
+                                          : 0;
+}
+
+constexpr bool logEnabled(LogModule module, LogLevel level) {
+    return static_cast<uint8_t>(level) <= logModuleLevel(module);
+}
+
+// One argument as stored in a record; the conversion in the format says which member.
+union LogArgument {
+    uint32_t u;
+    int32_t i;
+    const char *s;
+};
+
+inline LogArgument logArgument(const char *value) {
+    LogArgument argument;
+    argument.s = value;
+    return argument;
+}
+
+template <typename T>
+inline LogArgument logArgument(T value) {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                  "log arguments are integers, enums or string literals");
+    LogArgument argument;
+    if (std::is_signed<T>::value) {
+        argument.i = static_cast<int32_t>(value);
+    } else {
+        argument.u = static_cast<uint32_t>(value);
+    }
+    return argument;
+}
+
+struct LogRecord {
+    static const uint8_t MAX_ARGUMENTS = 8;
+    const char *format;
+    uint32_t millis;
+    LogModule module;
+    LogLevel level;
+    uint8_t argumentCount;
+    LogArgument arguments[MAX_ARGUMENTS];
+};
+
+// Bounded ring of log records.  Any task may add records; a record that does not fit is
+// dropped and counted rather than waited for.  drain() is only ever called from one task.
+class EspLog {
+public:
+    // Records held; a power of two so positions wrap with a mask.
+    static const uint16_t CAPACITY = 64;
+    static const size_t LINE_SIZE = 160;
+
+    EspLog();
+
+    template <typename... Args>
+    void record(LogModule module, LogLevel level, const char *format, Args... args) {
+        static_assert(sizeof...(Args) <= LogRecord::MAX_ARGUMENTS, "too many log arguments");
+        const LogArgument arguments[] = {logArgument(args)..., LogArgument()};
+        push(module, level, format, arguments, sizeof...(Args));
+    }
+
+    // Writes queued records to port as text lines, only as much as its TX buffer takes
+    // without waiting; a line cut short is finished on the next call.
+    void drain(HardwareSerial &port);
+
+    // Records dropped because the ring was full, since start-up.
+    uint32_t getDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        // pos + 1 once the record for position pos is written, pos + CAPACITY once read.
+        std::atomic<uint32_t> sequence;
+        LogRecord record;
+    };
+
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> writePosition;
+    uint32_t readPosition;
+    std::atomic<uint32_t> droppedCount;
+    uint32_t reportedDrops;
+    char line[LINE_SIZE];
+    size_t lineLength;
+    size_t lineSent;
+
+    void push(LogModule module, LogLevel level, const char *format, const LogArgument *arguments, uint8_t count);
+    bool pop(LogRecord &record);
+    void formatLine(const LogRecord &record);
+};
+
+// Console log, defined in EspLog.cpp.
+extern EspLog espLog;
+
+} // namespace ActuatorsController
+
+#define ESPLOG(module, level, ...)                                                                 \
+    do {                                                                                           \
+        if (ActuatorsController::logEnabled(ActuatorsController::LogModule::module,                \
+                                            ActuatorsController::LogLevel::level)) {               \
+            ActuatorsController::espLog.record(ActuatorsController::LogModule::module,             \
+                                               ActuatorsController::LogLevel::level, __VA_ARGS__); \
+        }                                                                                          \
+    } while (0)
@@ -0,0 +1,84 @@
+//
+// EspTask.h
+// Description: Pinned FreeRTOS tasks and the primitives they share on the ESP32.
+//
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+namespace ActuatorsController {
+
+// A task pinned to one core that calls its step function, then sleeps until notify() or for
+// its period, over and over.  It measures how much of each LOAD_WINDOW_US it spends in the
+// step, and its stack headroom can be read from any task, so /tasks can show both.
+class EspTask {
+public:
+    typedef void (*Step)(void *context);
+    static const uint32_t LOAD_WINDOW_US = 1000000;
+
+    EspTask(const char *name, uint32_t stackBytes, UBaseType_t priority, BaseType_t core, TickType_t period);
+    // Creates the task; returns false if FreeRTOS could not.
+    bool start(Step step, void *context);
+    // Wakes the task for its next step before its period is up.  Not for interrupts.
+    void notify();
+
+    const char *getName() const { return name; }
+    UBaseType_t getPriority() const { return priority; }
+    BaseType_t getCore() const { return core; }
+    // Share of the last full window spent in the step, in tenths of a percent.
+    uint16_t getLoadPermille() const { return loadPermille.load(std::memory_order_relaxed); }
+    // Longest single step so far, in microseconds.
+    uint32_t getMaxStepMicros() const { return maxStepMicros.load(std::memory_order_relaxed); }
+    // Least stack the task has had left so far, in bytes; 0 before it is started.
+    uint32_t getStackHighWater() const;
+
+private:
+    const char *name;
+    uint32_t stackBytes;
+    UBaseType_t priority;
+    BaseType_t core;
+    TickType_t period;
+    Step step;
+    void *context;
+    TaskHandle_t handle;
+    std::atomic<uint16_t> loadPermille;
+    std::atomic<uint32_t> maxStepMicros;
+
+    static void run(void *task);
+};
+
+// Mutex for the link objects (processors, executors, the bus) that the web task reaches
+// through /command and /link while the link task owns them.  A FreeRTOS mutex, so a low
+// priority holder inherits the link task's priority while it waits.
+class LinkLock {
+public:
+    LinkLock() : mutex(xSemaphoreCreateMutex()) {}
+
+    // Holds the lock for its scope; does nothing for a null lock, as on a single loop.
+    class Guard {
+    public:
+        explicit Guard(LinkLock *lock) : lock(lock) {
+            if (lock != nullptr) {
+                xSemaphoreTake(lock->mutex, portMAX_DELAY);
+            }
+        }
+        ~Guard() {
+            if (lock != nullptr) {
+                xSemaphoreGive(lock->mutex);
+            }
+        }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        LinkLock *lock;
+    };
+
+private:
+    SemaphoreHandle_t mutex;
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,143 @@
+//
+// LinkBus.h
+// Description: Polls several Megas sharing an RS-485 bus with the ESP32.
+//
+#pragma once
+#include <Arduino.h>
+#include "ActuatorCommandExecutor.h"
+#include "StatusReportProcessor.h"
+#include "link/LinkSchema.h"
+
+namespace ActuatorsController {
+
+// Holds the frames written for one node until that node's poll, since the ESP32 only
+// drives the bus while it polls.  Reads always come up empty; the bus reads for every node.
+class LinkOutbox : public Stream {
+public:
+    static const uint16_t CAPACITY = 512;
+
+    // A write that does not fit is dropped whole, so the Mega never sees half a frame.
+    size_t write(uint8_t value) override { return write(&value, 1); }
+    size_t write(const uint8_t *data, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    // Writes the frames held to the port, whole frames only and at most limit bytes, and
+    // keeps the rest for the next call.  Returns the number of bytes written.
+    uint16_t drainTo(Print &port, uint16_t limit);
+    uint16_t getDroppedCount() const { return droppedCount; }
+
+private:
+    uint8_t buffer[CAPACITY];
+    uint16_t length = 0;
+    uint16_t droppedCount = 0;
+};
+
+// Everything the ESP32 keeps for one Mega on the bus.
+struct LinkNode {
+    explicit LinkNode(uint8_t address) : address(address), executor(outbox, address), processor(outbox, address) {
+        processor.attachCommandExecutor(executor);
+    }
+
+    uint8_t address;
+    LinkOutbox outbox;
+    ActuatorCommandExecutor executor;
+    StatusReportProcessor processor;
+    // Polls sent, and polls the node did not finish with an END frame in time.
+    uint32_t pollCount = 0;
+    uint32_t timeoutCount = 0;
+};
+
+// The ESP32 is the bus master and polls each node in turn.  A poll sends up to
+// OUTBOX_BYTES_PER_POLL of the frames held in the node's outbox followed by a POLL frame,
+// then releases the bus.  The node answers with whatever it has queued, up to
+// LINK_BUS_TURN_BYTES, and an END frame; the next node is polled TURNAROUND_MICROS after
+// the END arrives, after POLL_TIMEOUT_MS without a frame from the node, or after
+// TURN_TIMEOUT_MS in all.
+//
+// Nothing waits on the UART: the poll's bytes fit the UART's transmit FIFO, and each
+// update() checks whether they are out, only waiting out the last RELEASE_TAIL_BYTES, so
+// the link lock is never held for a whole poll.  A full round takes at most
+// MAX_ROUND_MS, which stays below the heartbeat timeout.
+class LinkBus {
+public:
+    static const unsigned long POLL_TIMEOUT_MS = 25;
+    static const unsigned long TURN_TIMEOUT_MS = LINK_BUS_TURN_TIMEOUT_MS;
+    // Time a node that has sent END is given to release its driver; it does so on its next
+    // loop() once END is on the wire.
+    static const unsigned long TURNAROUND_MICROS = 2000;
+    // Together with the POLL frame this fits the UART's transmit FIFO, so writing a poll
+    // never blocks.  The rest of a busy outbox goes with the next poll.
+    static const uint16_t TX_FIFO_SIZE = 128;
+    // The POLL frame and the delimiter ahead of the poll.
+    static const uint16_t POLL_WIRE_SIZE = LINK_HEADER_SIZE + LINK_CRC_SIZE + 3;
+    static const uint16_t OUTBOX_BYTES_PER_POLL = 112;
+    // Bytes still to go when the driver release may wait for them: a little more than the
+    // bus carries between two steps of the link task, which runs every millisecond.
+    static const int RELEASE_TAIL_BYTES = 16;
+    // Longest time a poll keeps the driver on, and the longest round of LINK_MAX_NODES.
+    static const unsigned long MAX_POLL_SEND_MS =
+        (OUTBOX_BYTES_PER_POLL + POLL_WIRE_SIZE) * 10UL * 1000UL / LINK_BAUD_RATES[0] + 1;
+    static const unsigned long MAX_ROUND_MS =
+        LINK_MAX_NODES * (MAX_POLL_SEND_MS + TURN_TIMEOUT_MS + TURNAROUND_MICROS / 1000 + 1);
+    // Bytes taken from the UART per read.
+    static const size_t READ_CHUNK = 64;
+
+    // dePin drives the transceiver's DE and /RE pins.
+    LinkBus(HardwareSerial &port, int dePin);
+    // Adds a node to the round; returns false if LINK_MAX_NODES are attached already.
+    bool addNode(LinkNode &node);
+    // Call from setup(), after the port is started.
+    void begin();
+    // Call every loop(): polls the nodes and hands their frames to their processors.
+    // Returns true if any node's report or link state changed.
+    bool update();
+
+    uint8_t getNodeCount() const { return nodeCount; }
+    LinkNode &getNodeAt(uint8_t position) { return *nodes[position]; }
+    // Node with the given address, or null if it is not on the bus.
+    LinkNode *findNode(uint8_t address);
+    // Report of one node, or null if it is not on the bus.
+    const StatusReportData *getReport(uint8_t address);
+    // Frame level error counters of the bus, shared by every node.
+    const LinkFrameDecoder &getDecoder() const { return decoder; }
+    // Full rounds of polls, and frames from addresses no node is attached for.
+    uint32_t getRoundCount() const { return roundCount; }
+    uint16_t getStrayFrameCount() const { return strayFrameCount; }
+    unsigned long getLastRoundMillis() const { return lastRoundMillis; }
+
+private:
+    HardwareSerial &port;
+    int dePin;
+    LinkNode *nodes[LINK_MAX_NODES] = {};
+    uint8_t nodeCount = 0;
+    uint8_t current = 0;
+    // What availableForWrite() reports with nothing left to send, measured in begin().
+    int txIdle = 0;
+    // The driver is on and the poll is going out.
+    bool sending = false;
+    bool waiting = false;
+    bool turningAround = false;
+    unsigned long turnaroundStart = 0;
+    unsigned long pollStart = 0;
+    unsigned long lastHeard = 0;
+    unsigned long roundStart = 0;
+    unsigned long lastRoundMillis = 0;
+    uint32_t roundCount = 0;
+    uint16_t strayFrameCount = 0;
+    LinkFrameDecoder decoder;
+
+    bool receive();
+    bool dispatch(const LinkFrame &frame);
+    void poll(LinkNode &node);
+    bool releaseDriver();
+    void nextNode();
+};
+
+static_assert(LinkBus::OUTBOX_BYTES_PER_POLL >= LINK_MAX_ENCODED_SIZE, "a poll must carry at least one whole frame");
+static_assert(LinkBus::OUTBOX_BYTES_PER_POLL + LinkBus::POLL_WIRE_SIZE <= LinkBus::TX_FIFO_SIZE, "a poll must fit the UART");
+static_assert(LinkBus::MAX_ROUND_MS < LinkHeartbeat::TIMEOUT_MS, "every node must be polled within the heartbeat timeout");
+
+} // namespace ActuatorsController
@@ -0,0 +1,71 @@
+//
+// LinkClockSync.h
+// Description: Maps the Mega's millis() onto the ESP32's clock and wall-clock time.
+//
+#pragma once
+#include <Arduino.h>
+#include "link/LinkSchema.h"
+
+namespace ActuatorsController {
+
+// Every heartbeat from the Mega already carries the four timestamps of an NTP exchange: the
+// ESP32's send time it echoes (t1), its own receive time (t2 = t3 - echoDelay), its send time
+// (t3) and, on arrival, the ESP32's receive time (t4).  Each gives an offset between the two
+// millis() clocks, good to half the round trip.  The best sample of every WINDOW_SAMPLES
+// heartbeats is kept, and the offsets of kept samples at least DRIFT_BASELINE_MS apart give
+// the rate at which the Mega's resonator runs ahead of or behind the ESP32's crystal.
+//
+// Wall-clock time comes from SNTP once the ESP32 has it; before that only the ESP32 millis()
+// mapping is available.
+class LinkClockSync {
+public:
+    static const uint8_t WINDOW_SAMPLES = 8;
+    // Samples with a longer round trip are too uncertain to use.
+    static const uint16_t MAX_RTT_MS = 50;
+    static const uint32_t DRIFT_BASELINE_MS = 30000;
+
+    LinkClockSync();
+    // Call for every heartbeat from the Mega; localBootId is the ESP32's own, to skip echoes
+    // of heartbeats it sent before it restarted.
+    void addSample(const HeartbeatMessage &message, uint32_t now, uint16_t localBootId);
+    // Forgets everything, e.g. when the Mega restarted and its millis() started over.
+    void reset();
+
+    bool isSynced() const { return synced; }
+    // ESP32 millis() at which the Mega's millis() read megaMillis.  Only meaningful once synced.
+    uint32_t toLocal(uint32_t megaMillis) const;
+    // Unix time in ms at which the Mega's millis() read megaMillis, or 0 while either the
+    // link clock or SNTP is not synced.
+    uint64_t toWallClock(uint32_t megaMillis) const;
+    // Unix time in ms now, or 0 before SNTP has set the clock.
+    static uint64_t wallClockNow();
+
+    // Mega millis() minus ESP32 millis() at the last kept sample, as a signed number.
+    int32_t getOffset() const { return static_cast<int32_t>(offset); }
+    // Parts per million the Mega's clock runs fast (positive) or slow.
+    int32_t getDriftPpm() const { return driftPpm; }
+    uint16_t getBestRtt() const { return offsetRtt; }
+    uint32_t getSampleCount() const { return sampleCount; }
+
+private:
+    bool synced;
+    // Offset of the last kept sample and the ESP32 millis() it was taken at.
+    uint32_t offset;
+    uint32_t offsetLocal;
+    uint16_t offsetRtt;
+    // Kept sample the drift is measured from.
+    uint32_t referenceOffset;
+    uint32_t referenceLocal;
+    int32_t driftPpm;
+    bool driftKnown;
+    // Best sample of the current window.
+    uint8_t windowCount;
+    uint16_t windowRtt;
+    uint32_t windowOffset;
+    uint32_t windowLocal;
+    uint32_t sampleCount;
+
+    void keep(uint32_t sampleOffset, uint32_t sampleLocal, uint16_t rtt);
+};
+
+} // namespace ActuatorsController
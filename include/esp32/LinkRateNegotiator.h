@@ -0,0 +1,75 @@
+//
+// LinkRateNegotiator.h
+// Description: Raises the Mega link to the fastest baud rate that passes a test pattern.
+//
+#pragma once
+#include <Arduino.h>
+#include "link/LinkHeartbeat.h"
+#include "link/LinkSchema.h"
+
+namespace ActuatorsController {
+
+// Both boards start at LINK_BAUD_RATES[0].  Once the link has been up for SETTLE_MS the
+// next faster rate is tried: a BAUD TRY frame is sent, both UARTs switch, and PROBE_COUNT
+// test patterns are sent for the Mega to echo.  If every echo comes back intact with no
+// frame errors the rate is kept with BAUD KEEP and the next one is tried; otherwise both
+// boards return to the last kept rate and that rate becomes the ceiling for RETRY_MS.
+//
+// A burst of frame errors at a raised rate, or FALLBACK_MS without a valid frame, drops the
+// link back to the starting rate.  The Mega notices the silence and follows.
+class LinkRateNegotiator {
+public:
+    static const uint8_t PROBE_COUNT = 8;
+    static const unsigned long SETTLE_MS = 2000;
+    static const unsigned long SWITCH_DELAY_MS = 20;  // time for the Mega to switch too
+    static const unsigned long TRY_TIMEOUT_MS = 300;  // under the Mega's 500 ms
+    static const unsigned long FALLBACK_MS = 1500;
+    static const unsigned long ERROR_WINDOW_MS = 1000;
+    static const uint16_t ERROR_LIMIT = 3;            // frame errors per window at a raised rate
+    static const unsigned long RETRY_MS = 600000;     // a lowered ceiling is lifted after 10 min
+
+    explicit LinkRateNegotiator(HardwareSerial &port);
+    // Call every loop(); the heartbeat and decoder tell how the link is doing.
+    void update(const LinkHeartbeat &heartbeat, const LinkFrameDecoder &decoder);
+    // Counts an echoed PROBE frame from the Mega.
+    void handleProbe(const LinkFrame &frame);
+
+    uint32_t getBaudRate() const { return LINK_BAUD_RATES[rateIndex]; }
+    // Fastest rate that will be tried; lowered by failed tries and error bursts.
+    uint32_t getCeiling() const { return LINK_BAUD_RATES[ceilingIndex]; }
+    uint16_t getTryCount() const { return tryCount; }
+    uint16_t getFailedTryCount() const { return failedTryCount; }
+    uint16_t getErrorFallbackCount() const { return errorFallbackCount; }
+    uint16_t getSilenceFallbackCount() const { return silenceFallbackCount; }
+
+private:
+    HardwareSerial &port;
+    uint8_t rateIndex = 0;
+    uint8_t keptIndex = 0;
+    uint8_t ceilingIndex = LINK_BAUD_RATE_COUNT - 1;
+    bool trying = false;
+    bool probesSent = false;
+    uint8_t echoCount = 0;
+    unsigned long tryStart = 0;
+    unsigned long upSince = 0;
+    unsigned long ceilingLowered = 0;
+    unsigned long errorWindowStart = 0;
+    uint16_t errorsAtWindowStart = 0;
+    uint16_t errorsAtProbe = 0;
+    uint16_t tryCount = 0;
+    uint16_t failedTryCount = 0;
+    uint16_t errorFallbackCount = 0;
+    uint16_t silenceFallbackCount = 0;
+
+    void startTry(uint8_t index);
+    void endTry(bool clean);
+    void sendBaud(uint8_t index, BaudAction action);
+    void sendProbes();
+    void switchTo(uint8_t index);
+    void lowerCeiling(uint8_t index);
+    bool writeFrame(LinkFrameWriter &frame);
+    // Wraps like the decoder's counters; only differences are used.
+    static uint16_t errorCount(const LinkFrameDecoder &decoder);
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,77 @@
+//
+// PageSink.h
+// Description: Fixed-size output buffer the page builders write their HTML into.
+//
+#pragma once
+#include <Arduino.h>
+#include <WebServer.h>
+
+namespace ActuatorsController {
+
+// The builders write a page piece by piece instead of returning Strings, so the page never
+// exists in one piece: every CHUNK_SIZE bytes are handed to emit() as the buffer fills, and
+// a request needs no more memory for its page than this buffer.
+class PageSink {
+public:
+    static const size_t CHUNK_SIZE = 512;
+
+    PageSink();
+    virtual ~PageSink() {}
+    void write(const char *text);
+    void write(const char *text, size_t length);
+    void write(const String &text) { write(text.c_str(), text.length()); }
+    void write(uint32_t value);
+    // Hands over whatever is still buffered.
+    void flush();
+    uint32_t getBytesWritten() const { return bytesWritten; }
+
+protected:
+    virtual void emit(const char *data, size_t length) = 0;
+
+private:
+    char buffer[CHUNK_SIZE];
+    size_t used;
+    uint32_t bytesWritten;
+};
+
+// Collects the page into a String, for callers that still want it whole.
+class StringPageSink : public PageSink {
+public:
+    explicit StringPageSink(String &target) : target(target) {}
+
+protected:
+    void emit(const char *data, size_t length) override;
+
+private:
+    String &target;
+};
+
+// Sends the page as an HTTP/1.1 chunked response, one chunk per CHUNK_SIZE bytes, and times
+// how long the first and the last byte took from the sink's construction.  Headers other
+// than the content type are set on the server before the first chunk goes.
+class ChunkedResponseSink : public PageSink {
+public:
+    ChunkedResponseSink(WebServer &server, const char *contentType);
+    // Sends what is buffered and the empty chunk that ends the response.
+    void finish();
+    // Microseconds to the first chunk and to the end of the response; 0 until sent.
+    uint32_t getFirstByteTime() const { return firstByteTime; }
+    uint32_t getTotalTime() const { return totalTime; }
+    uint16_t getChunkCount() const { return chunkCount; }
+
+protected:
+    void emit(const char *data, size_t length) override;
+
+private:
+    WebServer &server;
+    const char *contentType;
+    uint32_t startedAt;
+    uint32_t firstByteTime;
+    uint32_t totalTime;
+    uint16_t chunkCount;
+    bool started;
+
+    void start();
+};
+
+} // namespace ActuatorsController
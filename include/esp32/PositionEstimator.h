@@ -0,0 +1,24 @@
+//
+// PositionEstimator.h
+// Description: Extrapolates actuator positions between the Mega's reports.
+//
+#pragma once
+#include <Arduino.h>
+#include "StatusReportFormatter.h"
+
+namespace ActuatorsController {
+
+// Positions are milliseconds of travel, as on the Mega: an extending actuator gains one per
+// millisecond and a retracting one loses one.  Between reports the ESP32 carries a moving
+// actuator on from its last reported position at that rate, held to [0, maxDuration], and
+// the next report replaces the estimate outright.  Stopped actuators stay where reported.
+class PositionEstimator {
+public:
+    // Estimated position of an actuator at ESP32 time now.
+    static uint32_t estimate(const ActuatorData &actuator, uint32_t now);
+    // Replaces each reported actuator's position by its estimate at now; returns true if
+    // any of them is moving, so its estimate will keep changing.
+    static bool apply(StatusReportData &report, uint32_t now);
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,46 @@
+//
+// ReportSnapshot.h
+// Description: Lock-free hand-off of a Mega's report from the link task to its readers.
+//
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "StatusReportFormatter.h"
+
+namespace ActuatorsController {
+
+// Two copies of the report.  publish() writes the one readers are not pointed at and then
+// switches them over with one atomic store, so the writer never waits.  Each copy carries
+// a seqlock counter that is odd while the copy is being written; a reader that raced with
+// a write, which takes two publishes during its own copy, sees the counter move and copies
+// again.  Neither side takes a lock, so the link task is never held up by the web task.
+//
+// Only one task may publish.  Any number may read.
+class ReportSnapshot {
+public:
+    ReportSnapshot();
+
+    void publish(const StatusReportData &report);
+    // Copies the newest report into report and returns its publish number, or returns 0
+    // and leaves report alone if nothing has been published yet.
+    uint32_t read(StatusReportData &report) const;
+
+    // Reports published so far; a reader can skip read() while this has not moved.
+    uint32_t getPublishCount() const { return publishCount.load(std::memory_order_acquire); }
+    // Copies readers had to redo because a publish overtook them.
+    uint32_t getRetryCount() const { return retryCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Buffer {
+        std::atomic<uint32_t> sequence;
+        uint32_t publishNumber;
+        StatusReportData report;
+    };
+
+    Buffer buffers[2];
+    std::atomic<uint8_t> current;
+    std::atomic<uint32_t> publishCount;
+    mutable std::atomic<uint32_t> retryCount;
+};
+
+} // namespace ActuatorsController
@@ -5,35 +5,61 @@
 #pragma once
 
 #include <Arduino.h>
+#include <type_traits>
 // we must include this from the mega side of the project as we are building web equivalents of the buttons.
 #include "mega/inputmapping.h"
+#include "link/LinkProtocol.h"
 
 namespace ActuatorsController {
 
 // This class processes the status report from the Mega.
-// Structure to hold individual actuator data.
+// Structure to hold individual actuator data.  Plain fixed-width fields only, largest
+// first, so a whole report copies with one memcpy and nothing in it touches the heap.
     struct ActuatorData {
-      int index;
-      String name;
+      // Unix time in ms of the Mega's report, or 0 until the clocks are synced.
+      uint64_t wallTime;
+      uint32_t timestamp;
+      uint32_t position;
+      uint32_t maxDuration;
+      // ESP32 millis() when position was last reported or the actuator started or stopped,
+      // by the Mega's timestamp once the clocks are synced and by arrival until then;
+      // PositionEstimator extrapolates from here.
+      uint32_t receivedAt;
+      // Bumped whenever a frame changes this actuator; 0 until the first one arrives.
+      uint16_t generation;
+      uint8_t node; // Mega the actuator belongs to
+      uint8_t index; // also its row in inputMappings, which both boards share
+      LinkMode mode;
       bool active;
-      String mode;
-      int position;
-      int maxDuration;
-      unsigned long timestamp;
       bool forceMode;
+
+      // Name from inputMappings; empty until the actuator has been reported.
+      const char *name() const {
+        return generation != 0 && index < MAX_INPUTS_COUNT ? inputMappings[index].actuatorName : "";
+      }
     };
 
     // Structure to hold the overall report data; note we use a fixed‐size array.
+    // One report per Mega, so (node, index) names an actuator across an RS-485 bus.
     struct StatusReportData {
-      unsigned long timestamp;
+      static const uint8_t MAX_ACTUATORS = 10;
+      // Unix time in ms of the last report, or 0 until the clocks are synced.
+      uint64_t wallTime;
+      uint32_t timestamp;
+      // The Mega's timestamp on the ESP32's millis() clock; arrival time while not timeSynced.
+      uint32_t localTimestamp;
+      // Bumped whenever any actuator changes.
+      uint16_t generation;
+      uint8_t node;
       bool forceMode;
-      static const int MAX_ACTUATORS = 10;
+      bool timeSynced;
       // maximum number of actuators
       ActuatorData actuators[MAX_ACTUATORS];
       uint8_t actuatorCount;
-      // creating a variable to hold the status message.
-      String statusMessage;
+      // Link state for the page, a string literal; empty until the link state is known.
+      const char *statusMessage;
     };
+    static_assert(std::is_trivially_copyable<StatusReportData>::value, "StatusReportData must copy with memcpy");
 
 class StatusReportFormatter {
 public:
@@ -5,23 +5,74 @@
 #pragma once
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include "StatusReportFormatter.h"
+#include "ActuatorCommandExecutor.h"
+#include "LinkRateNegotiator.h"
 #include "esp32Config.h"
+#include "LinkClockSync.h"
+#include "link/LinkHeartbeat.h"
+#include "link/LinkSchema.h"
 
 namespace ActuatorsController {
 
 
   class StatusReportProcessor {
   public:
-    // Constructor: takes a reference to an input Stream (e.g., Serial2)
-    StatusReportProcessor(Stream &inputStream) : inStream(inputStream), report () {}
-    // Process incoming JSON data. If a complete report is read, fills in 'report'
-    // and returns true; otherwise returns false.
+    // Constructor: takes a reference to an input Stream (e.g., Serial2) and the node address
+    // of the Mega whose frames it handles; frames from other nodes are ignored.
+    StatusReportProcessor(Stream &inputStream, uint8_t node = LINK_FIRST_NODE) :
+      inStream(inputStream), node(node), report (), heartbeat(static_cast<uint16_t>(random(1, 0x10000))) {
+      report.node = node;
+    }
+    // Process incoming link frames. If at least one STATUS frame was applied to 'report'
+    // returns true; otherwise returns false.
     // Predeclarations
     const StatusReportData& getReport() const;
     static void printReport(const StatusReportData &report);
+    static const char *modeName(LinkMode mode);
     bool process(Stream &dataStream);
+    // Handles one decoded frame, for a caller that runs the decoder itself (e.g. the RS-485
+    // bus, which shares one between every node).  Returns true if it updated the report.
+    bool handleFrame(const LinkFrame &frame);
+    uint8_t getNode() const { return node; }
+    // ACK frames found in the stream are handed to this executor.
+    void attachCommandExecutor(ActuatorCommandExecutor &executor) { commandExecutor = &executor; }
+    // PROBE echoes found in the stream are handed to this negotiator.
+    void attachRateNegotiator(LinkRateNegotiator &negotiator) { rateNegotiator = &negotiator; }
+    const LinkRateNegotiator *getRateNegotiator() const { return rateNegotiator; }
+    // Frame level error counters of the link.
+    const LinkFrameDecoder &getDecoder() const { return decoder; }
+    // Time taken to decode the most recent STATUS frame, and the longest so far, for comparing
+    // parser changes on the board.
+    unsigned long getLastDecodeMicros() const { return lastDecodeMicros; }
+    unsigned long getMaxDecodeMicros() const { return maxDecodeMicros; }
+    // Sequence gaps seen in frames from the Mega, the frames they covered, and the RESYNC
+    // requests sent to have them repaired.
+    uint16_t getGapCount() const { return gapCount; }
+    uint32_t getMissedFrameCount() const { return missedFrameCount; }
+    uint16_t getResyncRequestCount() const { return resyncRequestCount; }
+    // Frames that arrived after a later one; the Mega numbers frames as it sends them, so
+    // these point at a duplicated frame or a Mega restart not yet announced by its heartbeat.
+    uint16_t getLateFrameCount() const { return lateFrameCount; }
+    // Sends a heartbeat to the Mega when one is due; call every loop().
+    void serviceHeartbeat();
+    // Updates the report's status message when the link goes up or down.  Returns true if it
+    // changed, so the page can be rebuilt even though no frame arrived.
+    bool checkLinkState();
+    bool isLinkUp() const { return linkUp; }
+    uint16_t getLinkDownCount() const { return linkDownCount; }
+    // Asks the Mega to send every actuator's full state in one frame.  Done automatically
+    // when the first frame arrives after boot or after the link was down.
+    bool requestSnapshot();
+    uint16_t getSnapshotRequestCount() const { return snapshotRequestCount; }
+    // Liveness of the Mega and round trip times of the link.
+    const LinkHeartbeat &getHeartbeat() const { return heartbeat; }
+    // The Mega's clock as seen from the ESP32, from the heartbeat timestamps.
+    const LinkClockSync &getClockSync() const { return clockSync; }
+    // Time from the Mega stamping a STATUS frame to the ESP32 having applied it, for the most
+    // recent frame and the slowest so far, in ms; only counted while the clocks are synced.
+    uint32_t getLastEventLatency() const { return lastEventLatency; }
+    uint32_t getMaxEventLatency() const { return maxEventLatency; }
 
 
   /**
@@ -29,21 +80,41 @@ namespace ActuatorsController {
     *
     *   **/
   private:
+    // Bytes taken from the stream per read; the ESP32 core hands them over in one call
+    // instead of taking its UART lock once per byte.
+    static const size_t READ_CHUNK = 64;
+    // A frame at most this far behind the expected sequence number counts as late; further
+    // behind, the Mega's numbering has started over.
+    static const int16_t LATE_FRAME_WINDOW = 64;
     Stream &inStream;
+    uint8_t node;
     StatusReportData report;
+    ActuatorCommandExecutor *commandExecutor = nullptr;
+    LinkRateNegotiator *rateNegotiator = nullptr;
+    LinkFrameDecoder decoder;
+    unsigned long lastDecodeMicros = 0;
+    unsigned long maxDecodeMicros = 0;
+    // Sequence number the next frame from the Mega should carry, once the first has arrived.
+    uint16_t expectedSequence = 0;
+    bool sequenceKnown = false;
+    uint16_t gapCount = 0;
+    uint32_t missedFrameCount = 0;
+    uint16_t resyncRequestCount = 0;
+    uint16_t lateFrameCount = 0;
+    LinkHeartbeat heartbeat;
+    LinkClockSync clockSync;
+    uint32_t lastEventLatency = 0;
+    uint32_t maxEventLatency = 0;
+    bool linkUp = false;
+    uint16_t linkDownCount = 0;
+    uint16_t snapshotRequestCount = 0;
     // predeclarations
-    String internalBuffer = "";
-    String accumulateSerialInput(Stream &stream);
-    String appendStreamToBuffer(Stream &stream, StatusReportData &reportData);
-    void clearBuffer();
-    String getBufferContents() const { return internalBuffer; }
-    bool parseReport(const String &jsonReport, StatusReportData &reportToParse);
-    bool payloadIsOversized(String &buffer);
-    String processPayload(const char* payload, size_t length);
-    String processInternalBuffer(StatusReportData &reportData);
-    bool purgeUntilStartMarker(String &buffer);
-    int stripEmHex(String & buffer, int markerPos);
-    void stripInvalidEntries(String &message);
+    void trackSequence(uint16_t sequence);
+    void requestResync(uint16_t firstSequence, uint8_t count);
+    void handleHeartbeat(const LinkFrame &frame);
+    bool writeFrame(LinkFrameWriter &frame);
+    void handleAcknowledgement(const LinkFrame &frame);
+    bool parseStatusFrame(const LinkFrame &frame, StatusReportData &reportToParse);
 
   };
-} // namespace ActuatorsController
\ No newline at end of file
+} // namespace ActuatorsController
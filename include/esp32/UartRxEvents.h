@@ -0,0 +1,54 @@
+//
+// UartRxEvents.h
+// Description: Wakes the link task when the Mega link's UART has received data.
+//
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "EspTask.h"
+
+namespace ActuatorsController {
+
+// The UART driver reports received data through its event queue once its FIFO holds
+// RX_FIFO_FULL bytes, or once the line has been idle for RX_TIMEOUT_SYMBOLS characters, which
+// is right after a frame's last byte.  Each event wakes the link task, so a frame is parsed
+// within a scheduler tick of arriving instead of on the task's next period, and the RX ring
+// is large enough to ride out a slow step.
+//
+// Latency is taken from the last event to the step that decoded frames from it, so it
+// covers the wake-up and the parse but not the idle timeout itself.
+class UartRxEvents {
+public:
+    // Replaces the core's 256 byte default.
+    static const size_t RX_BUFFER_SIZE = 2048;
+    static const uint8_t RX_TIMEOUT_SYMBOLS = 2;
+    static const uint8_t RX_FIFO_FULL = 64;
+    // Upper bounds of the latency histogram buckets, in microseconds; the last is open ended.
+    static const uint8_t LATENCY_BUCKETS = 6;
+    static const uint32_t LATENCY_BOUNDS[LATENCY_BUCKETS - 1];
+
+    explicit UartRxEvents(HardwareSerial &port);
+    // Call before port.begin(), which sizes the RX ring.
+    void configure();
+    // Call after port.begin(): turns on idle detection and wakes task on every event.
+    void attach(EspTask &task);
+    // Call from the step after it decoded one or more frames.
+    void noteFramesParsed();
+
+    uint32_t getEventCount() const { return eventCount.load(std::memory_order_relaxed); }
+    uint32_t getLastLatencyMicros() const { return lastLatencyMicros; }
+    uint32_t getMaxLatencyMicros() const { return maxLatencyMicros; }
+    uint32_t getLatencyCount(uint8_t bucket) const { return latencyCounts[bucket]; }
+
+private:
+    HardwareSerial &port;
+    EspTask *task;
+    // Written by the UART event task, read by the link task.
+    std::atomic<uint32_t> lastEventMicros;
+    std::atomic<uint32_t> eventCount;
+    uint32_t lastLatencyMicros;
+    uint32_t maxLatencyMicros;
+    uint32_t latencyCounts[LATENCY_BUCKETS];
+};
+
+} // namespace ActuatorsController
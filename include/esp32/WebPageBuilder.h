@@ -29,6 +29,8 @@ class WebPageBuilder {
     // Build and return the complete HTML page.
     // This method calls individual functions to generate parts of the page.
     virtual String buildPage(const StatusReportData &statusData);
+    // Writes the same page into out a piece at a time, for streaming it to a client.
+    virtual void writePage(PageSink &out, const StatusReportData &statusData);
 
 protected:
     // Returns the section including the title and links
@@ -47,6 +49,14 @@ protected:
     String jsLink;
     String navigationContent;
     String dynamicBodyContent;
+    // Header, navigation and footer only change with the setters above, so they are built
+    // once and kept until one of those is called.
+    String cachedHeader;
+    String cachedNavigation;
+    String cachedFooter;
+    bool staticPartsCached;
+    void invalidateStaticParts();
+    void cacheStaticParts();
 
     // Presistent web page building instances
     HeaderBuilder headerBuilder;
@@ -6,6 +6,15 @@
 
 #include <Arduino.h>
 #include <WebServer.h>
+#include "ActuatorCommandExecutor.h"
+#include "EspTask.h"
+#include "LinkBus.h"
+#include "ReportSnapshot.h"
+#include "StatusReportProcessor.h"
+#include "UartRxEvents.h"
+#include "WebPageBuilder.h"
+
+using namespace ActuatorsController;
 
 class WebServerManager {
   public:
@@ -15,15 +24,87 @@ class WebServerManager {
     void begin();
     // Should be called repeatedly from the main loop to process requests.
     void handleClient();
-    // Update the HTML page content and reset the root route handler.
-    void updatePageContent(const String &pageHTML);
+    // Sets the HTML served at the root until a report can be rendered there.  On an RS-485
+    // bus each Mega has its own page, served at /?node=N.
+    void updatePageContent(const String &pageHTML, uint8_t node = LINK_FIRST_NODE);
     // Returns the current HTML page content.
     String generateHTML();
+    // Enables the /command route, which forwards actuator commands to the Mega.  Attach one
+    // executor per Mega on a bus; requests pick one with node=N.
+    void attachCommandExecutor(ActuatorCommandExecutor &executor);
+    // Enables the /link route, which reports the link's frame and error counters, per Mega
+    // with node=N like /command.
+    void attachLinkDiagnostics(const StatusReportProcessor &processor);
+    // Adds the bus-wide counters of an RS-485 bus to /link.
+    void attachLinkBus(LinkBus &bus);
+    // Enables the /status route, which reports a Mega's actuators with their positions
+    // estimated at the time of the request, per Mega with node=N.
+    void attachReportSnapshot(const ReportSnapshot &snapshot, uint8_t node = LINK_FIRST_NODE);
+    // Renders each Mega's page from its snapshot when the page is requested, streaming it to
+    // the client in chunks as it is written.
+    void attachPageBuilder(WebPageBuilder &builder);
+    // Adds the UART event count and frame latency of the link's port to /link.
+    void attachRxEvents(const UartRxEvents &events);
+    // Makes /command and /link hold the lock while they use the link objects, which another
+    // task owns.
+    void attachLinkLock(LinkLock &lock);
+    // Enables the /tasks route, which reports each attached task's load and stack headroom.
+    void attachTask(const EspTask &task);
   private: // Underlying web server instance.
     WebServer server;
-    // The HTML content to be served at the root.
-    String pageContent;
-    // Root route handler that sends back the current pageContent.
+    // The HTML content to be served at the root, by node, until a report can be rendered.
+    String pageContent[LINK_MAX_NODES];
+    // Renders the pages; null until attachPageBuilder() is called.
+    WebPageBuilder *pageBuilder = nullptr;
+    // Publish number of the report each node's page was last rendered from; 0 for none.
+    uint32_t pagePublishNumbers[LINK_MAX_NODES] = {};
+    // Streamed pages, and the time to their first byte and last byte, in microseconds.
+    struct PageTiming {
+      uint32_t renders;
+      uint32_t firstByteLast;
+      uint32_t firstByteMax;
+      uint32_t totalLast;
+      uint32_t bytesLast;
+      uint16_t chunksLast;
+    };
+    PageTiming pageTiming = {};
+    // Send commands to the Megas, by node; null until attachCommandExecutor() is called.
+    ActuatorCommandExecutor *commandExecutors[LINK_MAX_NODES] = {};
+    // Latest reports, by node; null until attachReportSnapshot() is called.
+    const ReportSnapshot *reportSnapshots[LINK_MAX_NODES] = {};
+    // Sources of the link counters, by node; null until attachLinkDiagnostics() is called.
+    const StatusReportProcessor *linkProcessors[LINK_MAX_NODES] = {};
+    // Bus whose round counters /link adds; null on a direct link.
+    LinkBus *linkBus = nullptr;
+    // Receive events of the link's UART; null when it is polled.
+    const UartRxEvents *rxEvents = nullptr;
+    struct PageLatency {
+      uint32_t last;
+      uint32_t max;
+    };
+    PageLatency pageLatencies[LINK_MAX_NODES] = {};
+    // Records how long after the Mega's event a node's page first showed it, for /link.
+    void notePageLatency(uint32_t latency, uint8_t slot);
+    // Held while the handlers use the link objects; null when everything runs in one loop.
+    LinkLock *linkLock = nullptr;
+    static const uint8_t MAX_TASKS = 4;
+    const EspTask *tasks[MAX_TASKS] = {};
+    uint8_t taskCount = 0;
+    // Slot of the node named by the request's node argument, LINK_FIRST_NODE's without one.
+    // Returns LINK_MAX_NODES for an address out of range.
+    uint8_t requestedSlot();
+    // Root route handler that streams the node's page rendered from its latest report, or
+    // sends pageContent before there is one.
     void handleRoot();
+    // Renders the page from report straight into a chunked response.
+    void streamPage(uint8_t slot, const StatusReportData &report, uint32_t publishNumber);
+    // /command?action=extend&actuator=2 sends a command; /command?seq=12 reports its ACK state.
+    void handleCommand();
+    // /status reports each actuator's state and estimated position as plain text.
+    void handleStatus();
+    // /link reports frame, error, gap, resync and heartbeat counters as plain text.
+    void handleLinkDiagnostics();
+    // /tasks reports load, longest step and stack headroom per task as plain text.
+    void handleTasks();
 };
 
@@ -4,43 +4,28 @@
 #pragma once
 
 #include <Arduino.h>
-#define DEBUG_LEVEL 4 // 0 = no debug, 1 = debug level 1, 2 = debug level 2, 3 = debug level 3
-// globally shared buffer for json payloads.
-    constexpr int MAX_PAYLOAD_SIZE = 2048; // max size in bytes of the json payload.
-/** obsolete
-    static char BUFFER[MAX_PAYLOAD_SIZE];
-    static size_t BUFFERLEN = 0;
-    **/
-    const size_t HEADER_SIZE = 8;
-    static uint32_t expectedPayloadLength = 0;
-    constexpr int JSON_FIELD_COUNT = 11;
-    // Define our start and end markers.
-    const String startMarker = "{\"actuators\": [ {\"";
-    const String endMarker = "] }";
-    const char arrayStart = '{';
-    const char arrayEnd = '}';
-    static int endPos = 0;
-    static int startPos = 0;
-    static String bugLog = ""; // let users store bug output until they print it.
-/** debug data storage **/
-    static uint32_t lastPayloadSize = 0;
-    static char payloadHeader[HEADER_SIZE + 1] = "";
-/** end debug data storage **/
-
-// allow changing the log level for various code segments.
-#define CURRENT_LOG_LEVEL 1 //
-#define SET_BUG_LOG(val) \
-    do { \
-        if (CURRENT_LOG_LEVEL <= DEBUG_LEVEL) { \
-            bugLog += String(val); \
-        } \
-    } while (0)
-
-    #define DEBUG_PRINT(x) \
-        do {\
-          if (CURRENT_LOG_LEVEL <= DEBUG_LEVEL && bugLog.length() > 0) { \
-            Serial.println(String("[") + __FUNCTION__ + "] " + String(bugLog) + String("[/end_") +  __FUNCTION__ + "]"); \
-            bugLog = "";\
-          } \
-        } while (0)
+// Log levels: 0 = off, 1 = errors, 2 = warnings, 3 = info, 4 = debug.  Messages above their
+// module's level are compiled out (see EspLog.h); set a module's level here or with a build
+// flag to look into one part of the code without flooding the console with the rest.
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 3
+#endif
+#ifndef LOG_LEVEL_LINK
+#define LOG_LEVEL_LINK DEBUG_LEVEL
+#endif
+#ifndef LOG_LEVEL_STATUS
+#define LOG_LEVEL_STATUS DEBUG_LEVEL
+#endif
+#ifndef LOG_LEVEL_COMMAND
+#define LOG_LEVEL_COMMAND DEBUG_LEVEL
+#endif
+#ifndef LOG_LEVEL_RATE
+#define LOG_LEVEL_RATE DEBUG_LEVEL
+#endif
+#ifndef LOG_LEVEL_BUS
+#define LOG_LEVEL_BUS DEBUG_LEVEL
+#endif
 
+// Define when Serial2 goes through an RS-485 transceiver shared by several Megas; the value
+// is the GPIO driving its DE and /RE pins.  The Megas are listed in esp32_main.cpp.
+// #define LINK_RS485_DE_PIN 4
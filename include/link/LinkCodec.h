@@ -0,0 +1,81 @@
+//
+// LinkCodec.h
+// Description: COBS framing and CRC-16 primitives for the Mega <-> ESP32 link.
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ActuatorsController {
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+inline uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF) {
+    while (length--) {
+        crc ^= static_cast<uint16_t>(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Consistent Overhead Byte Stuffing: rewrites data so it contains no 0x00 bytes, which
+// leaves 0x00 free to mark the end of a frame.  Returns the encoded length, or 0 if the
+// output does not fit in capacity.
+inline size_t cobsEncode(const uint8_t *source, size_t length, uint8_t *destination, size_t capacity) {
+    if (capacity == 0) {
+        return 0;
+    }
+    size_t read = 0;
+    size_t write = 1;
+    size_t codeIndex = 0;
+    uint8_t code = 1;
+    while (read < length) {
+        if (write >= capacity) {
+            return 0;
+        }
+        if (source[read] == 0) {
+            destination[codeIndex] = code;
+            code = 1;
+            codeIndex = write++;
+            read++;
+        } else {
+            destination[write++] = source[read++];
+            if (++code == 0xFF) {
+                destination[codeIndex] = code;
+                code = 1;
+                if (write >= capacity) {
+                    return 0;
+                }
+                codeIndex = write++;
+            }
+        }
+    }
+    destination[codeIndex] = code;
+    return write;
+}
+
+// Reverses cobsEncode.  Decoding in place (destination == source) is safe.  Returns the
+// decoded length, or 0 if the input is not valid COBS.
+inline size_t cobsDecode(const uint8_t *source, size_t length, uint8_t *destination) {
+    size_t read = 0;
+    size_t write = 0;
+    while (read < length) {
+        uint8_t code = source[read++];
+        if (code == 0) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (read >= length) {
+                return 0;
+            }
+            destination[write++] = source[read++];
+        }
+        if (code < 0xFF && read < length) {
+            destination[write++] = 0;
+        }
+    }
+    return write;
+}
+
+} // namespace ActuatorsController
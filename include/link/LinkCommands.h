@@ -0,0 +1,85 @@
+//
+// LinkCommands.h
+// Description: Command dictionary shared by the Mega command parsers and the ESP32 sender.
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace ActuatorsController {
+
+// Operations the Mega accepts from the ESP32.
+enum class Opcode : uint8_t {
+    NONE,
+    EXTEND,
+    RETRACT,
+    PAUSE,
+    SNAPSHOT // send every actuator's full state
+};
+
+// Kind of argument that follows the command word.
+enum class ArgumentKind : uint8_t {
+    NONE,
+    ACTUATOR_OR_ALL // actuator number 1..TOTAL_ACTUATORS, or ALL
+};
+
+// Outcome of receiving a command; anything but OK is reported back in a NAK.
+enum class CommandStatus : uint8_t {
+    OK,
+    UNKNOWN_COMMAND,
+    BAD_ARGUMENT,
+    MALFORMED,
+    QUEUE_FULL
+};
+
+// One entry of the command dictionary.
+struct CommandSpec {
+    const char *word;
+    Opcode opcode;
+    ArgumentKind argument;
+};
+
+// Command dictionary; add new commands here.
+constexpr CommandSpec commandDictionary[] = {
+    {"EXTEND", Opcode::EXTEND, ArgumentKind::ACTUATOR_OR_ALL},
+    {"RETRACT", Opcode::RETRACT, ArgumentKind::ACTUATOR_OR_ALL},
+    {"PAUSE", Opcode::PAUSE, ArgumentKind::ACTUATOR_OR_ALL},
+    {"SNAPSHOT", Opcode::SNAPSHOT, ArgumentKind::NONE},
+};
+constexpr size_t COMMAND_COUNT = sizeof(commandDictionary) / sizeof(commandDictionary[0]);
+
+// Actuator argument value meaning every actuator.
+const uint8_t ALL_ACTUATORS = 0;
+
+// Looks a command word of the given length up in the dictionary; nullptr if unknown.
+inline const CommandSpec *findCommand(const char *word, size_t wordLength) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (strlen(commandDictionary[i].word) == wordLength &&
+            strncmp(commandDictionary[i].word, word, wordLength) == 0) {
+            return &commandDictionary[i];
+        }
+    }
+    return nullptr;
+}
+
+inline const CommandSpec *findCommand(Opcode opcode) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (commandDictionary[i].opcode == opcode) {
+            return &commandDictionary[i];
+        }
+    }
+    return nullptr;
+}
+
+inline const char *commandStatusName(CommandStatus commandStatus) {
+    switch (commandStatus) {
+        case CommandStatus::OK: return "OK";
+        case CommandStatus::UNKNOWN_COMMAND: return "UNKNOWN_COMMAND";
+        case CommandStatus::BAD_ARGUMENT: return "BAD_ARGUMENT";
+        case CommandStatus::QUEUE_FULL: return "QUEUE_FULL";
+        default: return "MALFORMED";
+    }
+}
+
+} // namespace ActuatorsController
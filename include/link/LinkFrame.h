@@ -0,0 +1,286 @@
+//
+// LinkFrame.h
+// Description: Encoder and decoder for the binary link frames described in LinkProtocol.h.
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "LinkCodec.h"
+#include "LinkProtocol.h"
+
+namespace ActuatorsController {
+
+// Builds one unencoded frame.  encode() appends the CRC and produces the COBS bytes that
+// go on the wire.
+class LinkFrameWriter {
+public:
+    explicit LinkFrameWriter(FrameType type) : length(LINK_HEADER_SIZE), overflow(false) {
+        raw[0] = LINK_PROTOCOL_VERSION;
+        raw[1] = static_cast<uint8_t>(type);
+        raw[2] = LINK_FIRST_NODE;
+        raw[3] = 0;
+        raw[4] = 0;
+    }
+
+    // Rebuilds a frame from the bytes data() returned, e.g. after they waited in a queue.  They
+    // may come in two parts; the sequence number is stamped again by encode().
+    LinkFrameWriter(const uint8_t *part1, size_t length1, const uint8_t *part2, size_t length2) :
+        length(0), overflow(false) {
+        if (length1 + length2 < LINK_HEADER_SIZE || length1 + length2 + LINK_CRC_SIZE > LINK_MAX_FRAME_SIZE) {
+            overflow = true;
+            return;
+        }
+        memcpy(raw, part1, length1);
+        memcpy(raw + length1, part2, length2);
+        length = static_cast<uint8_t>(length1 + length2);
+    }
+
+    // Node the frame comes from (Mega) or is addressed to (ESP32); LINK_FIRST_NODE by default.
+    void setNode(uint8_t node) {
+        raw[2] = node;
+    }
+
+    void putU8(uint8_t value) {
+        // always leave room for the CRC.
+        if (length + LINK_CRC_SIZE >= LINK_MAX_FRAME_SIZE) {
+            overflow = true;
+            return;
+        }
+        raw[length++] = value;
+    }
+
+    void putU16(uint16_t value) {
+        putU8(static_cast<uint8_t>(value & 0xFF));
+        putU8(static_cast<uint8_t>(value >> 8));
+    }
+
+    void putU32(uint32_t value) {
+        putU16(static_cast<uint16_t>(value & 0xFFFF));
+        putU16(static_cast<uint16_t>(value >> 16));
+    }
+
+    // True if more payload was written than a frame can hold; such a frame is never encoded.
+    bool hasOverflowed() const {
+        return overflow;
+    }
+
+    FrameType getType() const {
+        return static_cast<FrameType>(raw[1]);
+    }
+
+    // The unencoded header and payload written so far.
+    const uint8_t *data() const {
+        return raw;
+    }
+
+    uint8_t size() const {
+        return length;
+    }
+
+    // Bytes the frame takes on the wire once encoded: COBS adds one byte to a frame this
+    // short, then the CRC and the delimiter follow.
+    uint8_t wireSize() const {
+        return static_cast<uint8_t>(length + LINK_CRC_SIZE + 2);
+    }
+
+    // Stamps the sequence number, appends the CRC and writes the COBS-encoded frame and its
+    // 0x00 delimiter to out.  Returns the number of bytes written, or 0 if it did not fit.
+    size_t encode(uint16_t sequence, uint8_t *out, size_t capacity) {
+        if (overflow || capacity < 2) {
+            return 0;
+        }
+        raw[3] = static_cast<uint8_t>(sequence & 0xFF);
+        raw[4] = static_cast<uint8_t>(sequence >> 8);
+        uint16_t crc = crc16(raw, length);
+        raw[length] = static_cast<uint8_t>(crc & 0xFF);
+        raw[length + 1] = static_cast<uint8_t>(crc >> 8);
+        size_t encoded = cobsEncode(raw, length + LINK_CRC_SIZE, out, capacity - 1);
+        if (encoded == 0) {
+            return 0;
+        }
+        out[encoded] = 0;
+        return encoded + 1;
+    }
+
+private:
+    uint8_t raw[LINK_MAX_FRAME_SIZE];
+    uint8_t length;
+    bool overflow;
+};
+
+// Reads little-endian fields from a frame payload.  Reading past the end yields zeros and
+// marks the reader invalid, so a short payload can be rejected after parsing.
+class LinkPayloadReader {
+public:
+    LinkPayloadReader(const uint8_t *data, size_t length) : data(data), length(length), position(0), underflow(false) {}
+
+    uint8_t getU8() {
+        if (position >= length) {
+            underflow = true;
+            return 0;
+        }
+        return data[position++];
+    }
+
+    uint16_t getU16() {
+        uint16_t low = getU8();
+        return static_cast<uint16_t>(low | (static_cast<uint16_t>(getU8()) << 8));
+    }
+
+    uint32_t getU32() {
+        uint32_t low = getU16();
+        return low | (static_cast<uint32_t>(getU16()) << 16);
+    }
+
+    size_t remaining() const {
+        return length - position;
+    }
+
+    bool isValid() const {
+        return !underflow;
+    }
+
+private:
+    const uint8_t *data;
+    size_t length;
+    size_t position;
+    bool underflow;
+};
+
+// A decoded frame.  payload points into the decoder's buffer and is valid until the
+// decoder is fed again.
+struct LinkFrame {
+    FrameType type;
+    uint8_t node;
+    uint16_t sequence;
+    const uint8_t *payload;
+    uint8_t payloadLength;
+};
+
+// Assembles frames from received bytes.  Bytes are collected until the 0x00 delimiter,
+// then decoded in place and checked for length, CRC and protocol version.
+class LinkFrameDecoder {
+public:
+    LinkFrameDecoder() :
+        length(0), overflowed(false), frameCount(0), crcErrorCount(0), formatErrorCount(0), versionErrorCount(0) {
+        frame.type = FrameType::STATUS;
+        frame.node = LINK_FIRST_NODE;
+        frame.sequence = 0;
+        frame.payload = buffer;
+        frame.payloadLength = 0;
+    }
+
+    // Feeds one received byte.  Returns true when it completed a valid frame, which
+    // getFrame() then describes.
+    bool feed(uint8_t byte) {
+        if (byte != 0) {
+            append(&byte, 1);
+            return false;
+        }
+        return endFrame();
+    }
+
+    // Feeds a block of received bytes, copying each run up to a delimiter in one go.  Stops
+    // after the first byte that completes a valid frame, so getFrame() can be read before
+    // the rest is fed, and returns the number of bytes consumed; complete says whether a
+    // frame was completed.
+    size_t feed(const uint8_t *data, size_t count, bool &complete) {
+        complete = false;
+        size_t used = 0;
+        while (used < count && !complete) {
+            const uint8_t *delimiter = static_cast<const uint8_t *>(memchr(data + used, 0, count - used));
+            size_t run = delimiter != nullptr ? static_cast<size_t>(delimiter - (data + used)) : count - used;
+            append(data + used, run);
+            used += run;
+            if (delimiter == nullptr) {
+                break;
+            }
+            used++;
+            complete = endFrame();
+        }
+        return used;
+    }
+
+    const LinkFrame &getFrame() const {
+        return frame;
+    }
+
+    // Valid frames decoded since start-up.
+    uint16_t getFrameCount() const {
+        return frameCount;
+    }
+
+    // Frames dropped because their CRC did not match.
+    uint16_t getCrcErrorCount() const {
+        return crcErrorCount;
+    }
+
+    // Frames dropped for being oversized, too short or not valid COBS.
+    uint16_t getFormatErrorCount() const {
+        return formatErrorCount;
+    }
+
+    // Frames dropped because they were sent with another protocol version.
+    uint16_t getVersionErrorCount() const {
+        return versionErrorCount;
+    }
+
+private:
+    uint8_t buffer[LINK_MAX_ENCODED_SIZE];
+    uint8_t length;
+    bool overflowed;
+    LinkFrame frame;
+    uint16_t frameCount;
+    uint16_t crcErrorCount;
+    uint16_t formatErrorCount;
+    uint16_t versionErrorCount;
+
+    void append(const uint8_t *data, size_t count) {
+        size_t room = sizeof(buffer) - length;
+        if (count > room) {
+            count = room;
+            overflowed = true;
+        }
+        memcpy(buffer + length, data, count);
+        length += count;
+    }
+
+    bool endFrame() {
+        bool complete = finishFrame();
+        length = 0;
+        overflowed = false;
+        return complete;
+    }
+
+    bool finishFrame() {
+        if (length == 0) {
+            // back-to-back delimiters; nothing to decode.
+            return false;
+        }
+        size_t decoded = overflowed ? 0 : cobsDecode(buffer, length, buffer);
+        if (decoded < static_cast<size_t>(LINK_HEADER_SIZE + LINK_CRC_SIZE)) {
+            formatErrorCount++;
+            return false;
+        }
+        size_t crcPosition = decoded - LINK_CRC_SIZE;
+        uint16_t expected = static_cast<uint16_t>(buffer[crcPosition] | (buffer[crcPosition + 1] << 8));
+        if (crc16(buffer, crcPosition) != expected) {
+            crcErrorCount++;
+            return false;
+        }
+        if (buffer[0] != LINK_PROTOCOL_VERSION) {
+            versionErrorCount++;
+            return false;
+        }
+        frame.type = static_cast<FrameType>(buffer[1]);
+        frame.node = buffer[2];
+        frame.sequence = static_cast<uint16_t>(buffer[3] | (buffer[4] << 8));
+        frame.payload = buffer + LINK_HEADER_SIZE;
+        frame.payloadLength = static_cast<uint8_t>(crcPosition - LINK_HEADER_SIZE);
+        frameCount++;
+        return true;
+    }
+};
+
+} // namespace ActuatorsController
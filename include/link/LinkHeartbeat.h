@@ -0,0 +1,131 @@
+//
+// LinkHeartbeat.h
+// Description: Liveness, peer restart and round-trip time tracking for the board link.
+//
+#pragma once
+#include <stdint.h>
+#include "LinkSchema.h"
+
+namespace ActuatorsController {
+
+// Each board sends a HEARTBEAT every INTERVAL_MS carrying its boot ID and millis(), and
+// echoes the last heartbeat it received from the other board together with how long it
+// held it.  The sender of the original heartbeat then knows the round trip time without
+// the two clocks having to agree.  The link counts as up while any valid frame from the
+// peer arrived within the last TIMEOUT_MS, and a change of the peer's boot ID means the
+// peer restarted and has lost whatever state it held.
+class LinkHeartbeat {
+public:
+    static const uint16_t INTERVAL_MS = 200;
+    static const uint16_t TIMEOUT_MS = 500;
+    // Bucket i counts round trips shorter than 2^(i+1) ms; the last one counts the rest.
+    static const uint8_t RTT_BUCKETS = 8;
+    // Boot ID meaning "not heard from the peer yet".
+    static const uint16_t UNKNOWN_BOOT_ID = 0;
+
+    explicit LinkHeartbeat(uint16_t bootId) :
+        bootId(bootId == UNKNOWN_BOOT_ID ? 1 : bootId), peerBootId(UNKNOWN_BOOT_ID), peerTimestamp(0),
+        peerReceivedAt(0), lastSent(0), lastHeard(0), heardOnce(false), sentOnce(false), peerRestartCount(0),
+        lastRtt(0), rttHistogram() {}
+
+    // True when the next heartbeat should be sent.
+    bool isDue(unsigned long now) const {
+        return !sentOnce || now - lastSent >= INTERVAL_MS;
+    }
+
+    // Fills in the next heartbeat and marks it sent.
+    void fill(HeartbeatMessage &message, unsigned long now) {
+        message.bootId = bootId;
+        message.timestamp = static_cast<uint32_t>(now);
+        message.echoBootId = peerBootId;
+        message.echoTimestamp = peerTimestamp;
+        unsigned long held = now - peerReceivedAt;
+        message.echoDelay = peerBootId == UNKNOWN_BOOT_ID ? 0 : static_cast<uint16_t>(held > 0xFFFF ? 0xFFFF : held);
+        lastSent = now;
+        sentOnce = true;
+    }
+
+    // Call for every valid frame from the peer, heartbeat or not.
+    void noteFrame(unsigned long now) {
+        lastHeard = now;
+        heardOnce = true;
+    }
+
+    // Records a heartbeat from the peer.  Returns true if it came from a peer this board has
+    // not heard from since that peer booted, i.e. on first contact and after a peer restart.
+    bool receive(const HeartbeatMessage &message, unsigned long now) {
+        noteFrame(now);
+        bool newPeer = message.bootId != peerBootId;
+        if (newPeer && peerBootId != UNKNOWN_BOOT_ID) {
+            peerRestartCount++;
+        }
+        peerBootId = message.bootId;
+        peerTimestamp = message.timestamp;
+        peerReceivedAt = now;
+        // an echo of a heartbeat sent before this board restarted says nothing about the link.
+        if (message.echoBootId == bootId) {
+            unsigned long elapsed = now - message.echoTimestamp;
+            if (elapsed >= message.echoDelay) {
+                recordRtt(elapsed - message.echoDelay);
+            }
+        }
+        return newPeer;
+    }
+
+    bool isUp(unsigned long now) const {
+        return heardWithin(now, TIMEOUT_MS);
+    }
+
+    // True if a frame from the peer arrived in the last window ms.
+    bool heardWithin(unsigned long now, unsigned long window) const {
+        return heardOnce && now - lastHeard < window;
+    }
+
+    uint16_t getBootId() const {
+        return bootId;
+    }
+
+    uint16_t getPeerBootId() const {
+        return peerBootId;
+    }
+
+    // Boot ID changes seen after the first contact.
+    uint16_t getPeerRestartCount() const {
+        return peerRestartCount;
+    }
+
+    // Most recent round trip time in ms.
+    uint16_t getLastRtt() const {
+        return lastRtt;
+    }
+
+    uint16_t getRttCount(uint8_t bucket) const {
+        return bucket < RTT_BUCKETS ? rttHistogram[bucket] : 0;
+    }
+
+private:
+    uint16_t bootId;
+    uint16_t peerBootId;
+    uint32_t peerTimestamp;
+    unsigned long peerReceivedAt;
+    unsigned long lastSent;
+    unsigned long lastHeard;
+    bool heardOnce;
+    bool sentOnce;
+    uint16_t peerRestartCount;
+    uint16_t lastRtt;
+    uint16_t rttHistogram[RTT_BUCKETS];
+
+    void recordRtt(unsigned long rtt) {
+        lastRtt = static_cast<uint16_t>(rtt > 0xFFFF ? 0xFFFF : rtt);
+        uint8_t bucket = 0;
+        while (bucket < RTT_BUCKETS - 1 && rtt >= (2UL << bucket)) {
+            bucket++;
+        }
+        if (rttHistogram[bucket] < 0xFFFF) {
+            rttHistogram[bucket]++;
+        }
+    }
+};
+
+} // namespace ActuatorsController
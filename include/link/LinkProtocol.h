@@ -0,0 +1,78 @@
+//
+// LinkProtocol.h
+// Description: Binary frame format shared by the Mega and ESP32 firmwares.
+//
+// Every frame is COBS encoded and terminated by a single 0x00 byte.  Unencoded it is
+//   [version u8][type u8][node u8][sequence u16][payload ...][crc16 u16]
+// with multi-byte fields little-endian and the CRC covering everything before it.
+// node is the Mega the frame comes from or is meant for, so several Megas can share an
+// RS-485 bus with one ESP32; on the bus a Mega only transmits when polled.
+// A corrupted frame is discarded at the next 0x00, so a receiver resyncs within one frame.
+// The Mega numbers its frames consecutively as they go on the wire, so the ESP32 can spot a
+// lost frame by the gap it leaves and ask for exactly the actuators it carried to be sent again.  Both boards send
+// heartbeats, so each notices within a second when the other stops or restarts.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ActuatorsController {
+
+// Bump when the layout of any frame changes; receivers drop frames of other versions.
+const uint8_t LINK_PROTOCOL_VERSION = 6;
+const uint8_t LINK_HEADER_SIZE = 5;
+const uint8_t LINK_CRC_SIZE = 2;
+// Largest unencoded frame, header and CRC included.
+const uint8_t LINK_MAX_FRAME_SIZE = 96;
+const uint8_t LINK_MAX_PAYLOAD_SIZE = LINK_MAX_FRAME_SIZE - LINK_HEADER_SIZE - LINK_CRC_SIZE;
+// COBS adds one code byte per 254 data bytes plus one, and the 0x00 delimiter follows.
+const uint8_t LINK_MAX_ENCODED_SIZE = LINK_MAX_FRAME_SIZE + LINK_MAX_FRAME_SIZE / 254 + 2;
+
+enum class FrameType : uint8_t {
+    STATUS = 0x01,    // Mega -> ESP32: coalesced actuator states
+    ACK = 0x02,       // Mega -> ESP32: acknowledgement of a COMMAND
+    HEARTBEAT = 0x03, // both ways: liveness, boot ID and round trip time
+    PROBE = 0x04,     // both ways: test pattern sent while trying a baud rate, echoed by the Mega
+    END = 0x05,       // Mega -> ESP32: the Mega's bus turn is over
+    TRACE = 0x06,     // Mega -> console: binary debug record, see mega/MegaTrace.h
+    COMMAND = 0x10,   // ESP32 -> Mega: actuator command
+    RESYNC = 0x11,    // ESP32 -> Mega: frames that never arrived, to be repaired
+    BAUD = 0x12,      // ESP32 -> Mega: try or keep a baud rate
+    POLL = 0x13       // ESP32 -> Mega: the addressed Mega may transmit on the bus
+};
+
+// Mega node addresses run from LINK_FIRST_NODE; a direct Serial2 link uses LINK_FIRST_NODE.
+const uint8_t LINK_FIRST_NODE = 1;
+const uint8_t LINK_MAX_NODES = 8;
+// Frames to this node are for every Mega.
+const uint8_t LINK_NODE_BROADCAST = 0xFF;
+// Bytes a Mega may start sending in one bus turn; a frame in progress is finished unless
+// the turn has run out of time.
+const uint16_t LINK_BUS_TURN_BYTES = 192;
+// Longest the ESP32 waits for a Mega's END after polling it before it polls the next node,
+// so a Mega must not be transmitting any more by then.
+const uint16_t LINK_BUS_TURN_TIMEOUT_MS = 40;
+
+// UART rates the link may run at, slowest first.  Both boards start at the first and only
+// move up when the ESP32 has found the faster rate clean; 250k, 500k and 1M divide the
+// Mega's 16 MHz clock exactly.
+constexpr uint32_t LINK_BAUD_RATES[] = {115200, 250000, 500000, 1000000};
+const uint8_t LINK_BAUD_RATE_COUNT = sizeof(LINK_BAUD_RATES) / sizeof(LINK_BAUD_RATES[0]);
+
+// BAUD frame actions.
+enum class BaudAction : uint8_t {
+    TRY,  // switch to the rate now; go back to the last kept rate unless KEEP follows soon
+    KEEP  // the rate tested clean, stay on it
+};
+
+// Actuator mode as carried in STATUS frames.
+enum class LinkMode : uint8_t {
+    IDLE,
+    EXTENDING,
+    RETRACTING
+};
+
+// Payload layouts of each frame type are defined in LinkSchema.h.
+const uint8_t STATUS_FLAG_FORCE_MODE = 0x01;
+const uint8_t ACTUATOR_FLAG_ACTIVE = 0x01;
+
+} // namespace ActuatorsController
@@ -0,0 +1,159 @@
+//
+// LinkSchema.h
+// Description: Single definition of every link payload layout.
+//
+// Each message is an X-macro listing its fields in wire order as X(name, type).  From that
+// one list LINK_DEFINE_MESSAGE generates the struct, its encoded size and the encode and
+// decode functions, so the Mega serializer and the ESP32 parser cannot drift apart.
+// LINK_DEFINE_DELTA_MESSAGE does the same for messages that only carry changed fields.
+// To add a field, append it to the list and bump LINK_PROTOCOL_VERSION.
+#pragma once
+#include <stdint.h>
+#include "LinkFrame.h"
+
+namespace ActuatorsController {
+
+// Wire types usable in a schema; multi-byte fields are little-endian.
+inline void putField(LinkFrameWriter &writer, uint8_t value) { writer.putU8(value); }
+inline void putField(LinkFrameWriter &writer, uint16_t value) { writer.putU16(value); }
+inline void putField(LinkFrameWriter &writer, uint32_t value) { writer.putU32(value); }
+inline void getField(LinkPayloadReader &reader, uint8_t &value) { value = reader.getU8(); }
+inline void getField(LinkPayloadReader &reader, uint16_t &value) { value = reader.getU16(); }
+inline void getField(LinkPayloadReader &reader, uint32_t &value) { value = reader.getU32(); }
+
+#define LINK_SCHEMA_MEMBER(name, type) type name;
+#define LINK_SCHEMA_SIZE(name, type) + sizeof(type)
+#define LINK_SCHEMA_PUT(name, type) putField(writer, message.name);
+#define LINK_SCHEMA_GET(name, type) getField(reader, message.name);
+#define LINK_SCHEMA_BIT(name, type) name,
+#define LINK_SCHEMA_PUT_IF_PRESENT(name, type) \
+    if (message.present & (1U << Message::Field::name)) putField(writer, message.name);
+#define LINK_SCHEMA_GET_IF_PRESENT(name, type) \
+    if (message.present & (1U << Message::Field::name)) getField(reader, message.name);
+#define LINK_SCHEMA_DIFF(name, type) \
+    if (previous.name != current.name) changed |= 1U << Message::Field::name;
+
+// Defines struct Name with one member per field, Name::WIRE_SIZE, and
+//   encodeMessage(LinkFrameWriter&, const Name&)
+//   decodeMessage(LinkPayloadReader&, Name&)   -- false if the payload was too short
+#define LINK_DEFINE_MESSAGE(Name, FIELDS)                                        \
+    struct Name {                                                                \
+        FIELDS(LINK_SCHEMA_MEMBER)                                               \
+        static const uint8_t WIRE_SIZE = 0 FIELDS(LINK_SCHEMA_SIZE);             \
+    };                                                                           \
+    inline void encodeMessage(LinkFrameWriter &writer, const Name &message) {    \
+        FIELDS(LINK_SCHEMA_PUT)                                                  \
+    }                                                                            \
+    inline bool decodeMessage(LinkPayloadReader &reader, Name &message) {        \
+        FIELDS(LINK_SCHEMA_GET)                                                  \
+        return reader.isValid();                                                 \
+    }
+
+// Defines a delta message: KEY_FIELDS are always sent, followed by a presence bitmap and
+// then only those DELTA_FIELDS whose bit is set, in list order.  Name::Field::<field> is
+// the bit number of a delta field and Name::ALL_FIELDS sets every bit.  decodeMessage()
+// leaves fields that were not present untouched, and changedFields() returns the bits of
+// the delta fields that differ between two messages.
+#define LINK_DEFINE_DELTA_MESSAGE(Name, KEY_FIELDS, DELTA_FIELDS)                        \
+    struct Name {                                                                        \
+        struct Field {                                                                   \
+            enum : uint8_t { DELTA_FIELDS(LINK_SCHEMA_BIT) COUNT };                      \
+        };                                                                               \
+        static const uint8_t ALL_FIELDS = (1U << Field::COUNT) - 1;                      \
+        static const uint8_t MAX_WIRE_SIZE = 1 KEY_FIELDS(LINK_SCHEMA_SIZE)              \
+            DELTA_FIELDS(LINK_SCHEMA_SIZE);                                              \
+        KEY_FIELDS(LINK_SCHEMA_MEMBER)                                                   \
+        uint8_t present;                                                                 \
+        DELTA_FIELDS(LINK_SCHEMA_MEMBER)                                                 \
+    };                                                                                   \
+    static_assert(Name::Field::COUNT <= 8, #Name " has more delta fields than bits");   \
+    inline void encodeMessage(LinkFrameWriter &writer, const Name &message) {            \
+        typedef Name Message;                                                            \
+        KEY_FIELDS(LINK_SCHEMA_PUT)                                                      \
+        putField(writer, message.present);                                               \
+        DELTA_FIELDS(LINK_SCHEMA_PUT_IF_PRESENT)                                         \
+    }                                                                                    \
+    inline bool decodeMessage(LinkPayloadReader &reader, Name &message) {                \
+        typedef Name Message;                                                            \
+        KEY_FIELDS(LINK_SCHEMA_GET)                                                      \
+        getField(reader, message.present);                                               \
+        DELTA_FIELDS(LINK_SCHEMA_GET_IF_PRESENT)                                         \
+        return reader.isValid();                                                         \
+    }                                                                                    \
+    inline uint8_t changedFields(const Name &previous, const Name &current) {             \
+        typedef Name Message;                                                            \
+        uint8_t changed = 0;                                                             \
+        DELTA_FIELDS(LINK_SCHEMA_DIFF)                                                   \
+        return changed;                                                                  \
+    }
+
+// STATUS: one header followed by `count` entries.  Positions and durations are in
+// milliseconds of travel; mode is a LinkMode.
+#define STATUS_HEADER_FIELDS(X) \
+    X(timestamp, uint32_t)      \
+    X(flags, uint8_t)           \
+    X(count, uint8_t)
+
+// Each entry names its actuator and carries only the fields that changed since the last
+// frame for that actuator; a keyframe entry carries all of them.
+#define STATUS_ENTRY_KEY_FIELDS(X) \
+    X(index, uint8_t)
+
+#define STATUS_ENTRY_FIELDS(X) \
+    X(flags, uint8_t)          \
+    X(mode, uint8_t)           \
+    X(position, uint16_t)      \
+    X(maxDuration, uint16_t)
+
+// ACK: the acknowledged COMMAND sequence number and its CommandStatus.
+#define ACK_FIELDS(X)       \
+    X(sequence, uint16_t)   \
+    X(status, uint8_t)
+
+// COMMAND: an Opcode and an actuator number, 0 meaning all actuators.  The frame
+// sequence number is the command's sequence number.
+#define COMMAND_FIELDS(X) \
+    X(opcode, uint8_t)    \
+    X(actuator, uint8_t)
+
+// RESYNC: `count` consecutive Mega frame sequence numbers starting at firstSequence that the
+// ESP32 did not receive.  Frames sent from the ESP32 that are not commands carry sequence 0.
+#define RESYNC_FIELDS(X)         \
+    X(firstSequence, uint16_t)   \
+    X(count, uint8_t)
+
+// HEARTBEAT: the sender's boot ID and millis(), and the boot ID and timestamp of the last
+// heartbeat it received from the other board with the ms it held it; see LinkHeartbeat.h.
+#define HEARTBEAT_FIELDS(X)      \
+    X(bootId, uint16_t)          \
+    X(timestamp, uint32_t)       \
+    X(echoBootId, uint16_t)      \
+    X(echoTimestamp, uint32_t)   \
+    X(echoDelay, uint16_t)
+
+// BAUD: an index into LINK_BAUD_RATES and a BaudAction.
+#define BAUD_FIELDS(X)       \
+    X(rateIndex, uint8_t)    \
+    X(action, uint8_t)
+
+// PROBE: a numbered test pattern mixing zero, all-ones and alternating bytes, so that
+// framing, COBS and bit timing errors all show up as a pattern that does not match.
+#define PROBE_FIELDS(X)       \
+    X(number, uint8_t)        \
+    X(pattern0, uint32_t)     \
+    X(pattern1, uint32_t)     \
+    X(pattern2, uint32_t)     \
+    X(pattern3, uint32_t)
+
+const uint32_t PROBE_PATTERN[4] = {0x55AA00FFUL, 0x00FF55AAUL, 0x80402010UL, 0x01020408UL};
+
+LINK_DEFINE_MESSAGE(StatusHeaderMessage, STATUS_HEADER_FIELDS)
+LINK_DEFINE_DELTA_MESSAGE(StatusEntryMessage, STATUS_ENTRY_KEY_FIELDS, STATUS_ENTRY_FIELDS)
+LINK_DEFINE_MESSAGE(AckMessage, ACK_FIELDS)
+LINK_DEFINE_MESSAGE(CommandMessage, COMMAND_FIELDS)
+LINK_DEFINE_MESSAGE(ResyncMessage, RESYNC_FIELDS)
+LINK_DEFINE_MESSAGE(HeartbeatMessage, HEARTBEAT_FIELDS)
+LINK_DEFINE_MESSAGE(BaudMessage, BAUD_FIELDS)
+LINK_DEFINE_MESSAGE(ProbeMessage, PROBE_FIELDS)
+
+} // namespace ActuatorsController
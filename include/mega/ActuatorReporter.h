@@ -4,78 +4,219 @@
 #pragma once
 #include <Arduino.h>
 #include "MegaRelayControl.h"
+#include "MegaLink.h"
+#include "MegaTrace.h"
+#include "link/LinkSchema.h"
 
 
 
 namespace ActuatorsController {
 
+static_assert(MAX_RELAY_PINS <= 16, "ActuatorMask needs one bit per relay");
+static_assert(StatusHeaderMessage::WIRE_SIZE + MAX_RELAY_PINS * StatusEntryMessage::MAX_WIRE_SIZE <= LINK_MAX_PAYLOAD_SIZE,
+              "a STATUS frame must fit every relay");
+
+// Builds STATUS frames for the ESP32.  Only fields that changed since the last frame sent for
+// an actuator go on the wire; a keyframe entry carries every field.  Every actuator gets a
+// keyframe at start-up, when the ESP32 reports the frame that last carried it as lost, and in
+// rotation every KEYFRAME_INTERVAL, so lost frames are repaired without a full state dump.
 class ActuatorReporter {
 public:
-    // Constructor: stores a reference to the MegaRelayControl which holds relay and state information.
-    ActuatorReporter(MegaRelayControl &relayControl)
-        : relays(relayControl), lastReportTime(millis()) {}
+    // Every actuator is sent as a keyframe at least this often.
+    static const unsigned long KEYFRAME_INTERVAL = 10000UL; // ms
+
+    // Constructor: stores a reference to the MegaRelayControl which holds relay and state information,
+    // and the link which carries reports to the ESP32.
+    ActuatorReporter(MegaRelayControl &relayControl, MegaLink &link)
+        : relays(relayControl), link(link), lastReportTime(millis()), lastEncodeMicros(0),
+          keyframeMask(ALL_ACTUATORS_MASK), streamedMask(0), nextRotationIndex(0), lastRotationTime(millis()) {}
 
     // Virtual destructor (if you later subclass this reporter)
     virtual ~ActuatorReporter() = default;
 
-    // Generates a JSON-formatted report string with current actuator states.
-    String generateReport(int actuatorIndex) const {
-        relays.relayStates[actuatorIndex].stateHasChanged = false;
-        // we start in an array in case we choose to send multiple
-        // entries in the future.
-        String report = "{\"actuators\": [ {";
-        report += "\"actuatorCount\": 1"; // it's always 1 actuator for now
-        report += ", \"timestamp\": " + String(millis());
-        report += ", \"forceMode\": " + String(relays.isForceMode() ? "true" : "false"); // Report forced mode
-        // reset stateHasChanged now that reporting has been called
-        const auto &state = relays.relayStates[actuatorIndex];
-        report += ", \"index\": " + String(actuatorIndex);
-        report += ", \"active\": " + String(state.isActive ? "true" : "false");
-        report += ", \"actuatorName\": \"" + state.actuatorName + "\"";
-        report += R"(, "mode": ")";
-        if (state.isActive) {
-            report += (state.relayState != Mode::NONE ? state.relayState == Mode::EXTENDING ? "EXTENDING" : "RETRACTING" : "IDLE");
-        } else {
-            report += "IDLE";
+    // Fills a STATUS frame with every actuator in actuatorMask that has something new to report
+    // and returns the mask of those actually included.  The timestamp and force mode are shared
+    // by all entries, so they are sent once in the frame header.
+    ActuatorMask generateReport(ActuatorMask actuatorMask, LinkFrameWriter &frame) const {
+        StatusEntryMessage entries[MAX_RELAY_PINS];
+        ActuatorMask included = 0;
+        uint8_t count = 0;
+        for (int actuatorIndex = 0; actuatorIndex < MAX_RELAY_PINS; actuatorIndex++) {
+            if (!(actuatorMask & maskFor(actuatorIndex))) {
+                continue;
+            }
+            StatusEntryMessage &entry = entries[count];
+            readActuatorState(actuatorIndex, entry);
+            entry.present = (keyframeMask & maskFor(actuatorIndex)) ? StatusEntryMessage::ALL_FIELDS
+                                                                    : changedFields(lastSent[actuatorIndex], entry);
+            if (entry.present != 0 && (streamedMask & maskFor(actuatorIndex))) {
+                // the entry replaces any position update still queued for this actuator.
+                entry.present |= 1U << StatusEntryMessage::Field::position;
+            }
+            if (entry.present != 0) {
+                included |= maskFor(actuatorIndex);
+                count++;
+            }
+        }
+        encodeHeader(frame, count);
+        for (uint8_t i = 0; i < count; i++) {
+            encodeMessage(frame, entries[i]);
+        }
+        return included;
+    }
+
+    // Queues a single coalesced report for all actuators in actuatorMask on the ESP32 link.
+    // Returns false if the link queue had no room; the caller keeps the changes pending and retries.
+    bool sendStatusReport(ActuatorMask actuatorMask) {
+        if (actuatorMask == 0) {
+            return true;
+        }
+        unsigned long encodeStart = micros();
+        LinkFrameWriter frame(FrameType::STATUS);
+        ActuatorMask included = generateReport(actuatorMask, frame);
+        lastEncodeMicros = micros() - encodeStart;
+        if (included == 0) {
+            // nothing the ESP32 does not already know.
+            return true;
         }
-        report += "\", \"position\": " + String(state.actuatorPosition);
-        report += ", \"maxDuration\": " + String(state.maxDuration);
-        report += "}";
+        // forced operations bypass the travel limits, so they take the safety lane, unless an
+        // earlier frame for the same actuators still waits in the state lane; the link then
+        // keeps this one behind it.
+        TxPriority priority = relays.isForceMode() ? TxPriority::SAFETY : TxPriority::STATE;
+        if (!link.send(frame, priority, MegaTxScheduler::NO_MERGE, included)) {
+            return false;
+        }
+        // the frame is queued, so what it carried is now what the ESP32 will hold.  A position
+        // update still waiting on the PERIODIC lane is older than this frame and would undo it
+        // if sent afterwards, so it is dropped; this frame carries the position instead.
+        for (int actuatorIndex = 0; actuatorIndex < MAX_RELAY_PINS; actuatorIndex++) {
+            if (included & maskFor(actuatorIndex)) {
+                readActuatorState(actuatorIndex, lastSent[actuatorIndex]);
+                if (streamedMask & maskFor(actuatorIndex)) {
+                    link.supersede(TxPriority::PERIODIC, static_cast<uint8_t>(actuatorIndex));
+                }
+            }
+        }
+        keyframeMask &= ~included;
+        streamedMask &= ~included;
+        // DEBUG output; the link traces the frame's sequence number once it is on the wire.
+        trace<TraceId::STATUS_QUEUED>(included, lastEncodeMicros);
+        return true;
+    }
+
+    // Queues a position-only update for a moving actuator on the PERIODIC lane.  A newer
+    // update or STATUS frame for the same actuator supersedes one still waiting in the queue;
+    // the next STATUS entry for the actuator always carries its position.  Returns false
+    // if it could not be queued.  queuedBytes is the frame's size on the wire, or 0 when the
+    // position had not changed and nothing was sent.
+    bool sendPositionUpdate(int actuatorIndex, uint16_t &queuedBytes) {
+        queuedBytes = 0;
+        StatusEntryMessage entry;
+        readActuatorState(actuatorIndex, entry);
+        if (entry.position == lastSent[actuatorIndex].position) {
+            return true;
+        }
+        entry.present = 1U << StatusEntryMessage::Field::position;
+        LinkFrameWriter frame(FrameType::STATUS);
+        encodeHeader(frame, 1);
+        encodeMessage(frame, entry);
+        if (!link.send(frame, TxPriority::PERIODIC, static_cast<uint8_t>(actuatorIndex), maskFor(actuatorIndex))) {
+            return false;
+        }
+        lastSent[actuatorIndex].position = entry.position;
+        streamedMask |= maskFor(actuatorIndex);
+        queuedBytes = link.getLastFrameSize();
+        return true;
+    }
 
-        report += " ] }";
-        return report;
+    // Sends the given actuators with every field in their next report.
+    void requestKeyframe(ActuatorMask actuatorMask) {
+        keyframeMask |= actuatorMask;
     }
 
-    // Sends the report via Serial2 (assumed to be used for communication with the ESP32).
-    void sendStatusReport(int actuatorIndex) const {
-        String reportString = generateReport(actuatorIndex);
-        // Send the json prepared report encapsulated with payload data.
-        String encappedReport = encapsulateReport(reportString);
-        Serial2.println(encappedReport);
-        // DEBUG output
-        Serial.print (" Mega Local Output:\n");
-        Serial.println(encappedReport);
-        Serial.println ("End Output.\n");
+    // Schedules every actuator in full; they all fit in the next STATUS frame.
+    void requestSnapshot() {
+        keyframeMask = ALL_ACTUATORS_MASK;
+    }
+
+    // Actuators owed a keyframe: those the ESP32 asked to have repaired, and the next one in
+    // the periodic rotation when it is due.  The rotation refreshes one actuator at a time to
+    // keep the link load even.
+    ActuatorMask keyframesDue() {
+        keyframeMask |= link.takeResyncRequests() & ALL_ACTUATORS_MASK;
+        unsigned long now = millis();
+        if (now - lastRotationTime >= KEYFRAME_INTERVAL / MAX_RELAY_PINS) {
+            lastRotationTime = now;
+            keyframeMask |= maskFor(nextRotationIndex);
+            nextRotationIndex = (nextRotationIndex + 1) % MAX_RELAY_PINS;
+        }
+        return keyframeMask;
+    }
+
+    // The link the reports are queued on.
+    const MegaLink &getLink() const {
+        return link;
+    }
+
+    // Time taken to build the most recent status frame, for comparing encoder changes on the board.
+    unsigned long getLastEncodeMicros() const {
+        return lastEncodeMicros;
+    }
+
+    // Returns the mask bit for a single actuator index.
+    static ActuatorMask maskFor(int actuatorIndex) {
+        return static_cast<ActuatorMask>(1U << actuatorIndex);
     }
 
 private:
+    static const ActuatorMask ALL_ACTUATORS_MASK = static_cast<ActuatorMask>((1UL << MAX_RELAY_PINS) - 1);
+
     // Reference to the MegaRelayControl instance, from which we retrieve actuator states.
     MegaRelayControl &relays;
+    // Binary link to the ESP32.
+    MegaLink &link;
     // Timestamp of the last report sent.
     unsigned long lastReportTime;
     // Reporting interval in milliseconds (adjust as needed).
     static const unsigned long REPORT_INTERVAL = 1000UL;
+    // Duration of the last generateReport() call in microseconds.
+    unsigned long lastEncodeMicros;
+    // Field values last queued for each actuator; deltas are taken against these.
+    StatusEntryMessage lastSent[MAX_RELAY_PINS];
+    // Actuators whose next entry must carry every field.
+    ActuatorMask keyframeMask;
+    // Actuators with a position update queued since their last STATUS entry.
+    ActuatorMask streamedMask;
+    uint8_t nextRotationIndex;
+    unsigned long lastRotationTime;
+
+    void encodeHeader(LinkFrameWriter &frame, uint8_t entryCount) const {
+        StatusHeaderMessage header;
+        header.timestamp = millis();
+        header.flags = relays.isForceMode() ? STATUS_FLAG_FORCE_MODE : 0;
+        header.count = entryCount;
+        encodeMessage(frame, header);
+    }
+
+    // Reads the reported fields of one actuator.  The name is not sent; the ESP32 takes it
+    // from the shared inputMappings table.
+    void readActuatorState(int actuatorIndex, StatusEntryMessage &entry) const {
+        const auto &state = relays.relayStates[actuatorIndex];
+        LinkMode mode = LinkMode::IDLE;
+        if (state.isActive && state.relayState == Mode::EXTENDING) {
+            mode = LinkMode::EXTENDING;
+        } else if (state.isActive && state.relayState == Mode::RETRACTING) {
+            mode = LinkMode::RETRACTING;
+        }
+        entry.index = static_cast<uint8_t>(actuatorIndex);
+        entry.flags = state.isActive ? ACTUATOR_FLAG_ACTIVE : 0;
+        entry.mode = static_cast<uint8_t>(mode);
+        entry.position = clampToU16(relays.livePosition(actuatorIndex));
+        entry.maxDuration = clampToU16(state.maxDuration);
+    }
 
-    // encapsulate the report with a payload prediction so the receiver knows how much data to expect.
-    String encapsulateReport(const String &jsonReport) const {
-        // Determine the length of the JSON payload.
-        unsigned int payloadLength = jsonReport.length();
-        // Build an 8-character hexadecimal header.
-        // For example, a payload length of 1234 becomes "000004D2".
-        char header[9]; // 8 characters plus a null terminator.
-        snprintf(header, sizeof(header), "%08X", payloadLength);
-        // Return the header concatenated with the JSON report.
-        return String(header) + jsonReport;
+    static uint16_t clampToU16(unsigned long value) {
+        return value > 0xFFFFUL ? 0xFFFF : static_cast<uint16_t>(value);
     }
 
 };
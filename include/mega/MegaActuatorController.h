@@ -3,9 +3,12 @@
 //
 #pragma once
 #include <Arduino.h>
+#include "ActuatorReporter.h"
 #include "MegaCommand.h"
+#include "MegaCommandReceiver.h"
 #include "MegaRelayControl.h"
 #include "MegaLEDControl.h"
+#include "MegaTrace.h"
 
 namespace ActuatorsController {
 
@@ -13,31 +16,59 @@ class MegaActuatorController {
 public:
   MegaActuatorController(MegaRelayControl
                          & relayControl, MegaLEDControl& ledControl)
-    : relays(relayControl), leds(ledControl) {}
+    : relays(relayControl), leds(ledControl), reporter(nullptr) {}
+
+  // Reporter that answers SNAPSHOT commands; they are ignored until one is attached.
+  void attachReporter(ActuatorReporter& statusReporter) {
+    reporter = &statusReporter;
+  }
 
   void executeCommand(const ActuatorsController::MegaCommand& command) {
-    Serial.print ("Command: ");
-    Serial.println (command.getAction());
-    if (command.getAction() == "EXTEND") {
-      if (command.getActuator() == 0) {
-        Serial.println ("EXTENDING ALL");
-        relays.controlRelays(true);
-      } else {
-        relays.controlSingleActuator(command.getActuator());
-        Serial.print ("EXTENDING: ");
-        Serial.println (command.getActuator());
-      }
-      leds.setFullBrightness(true, true);
-    } else if (command.getAction() == "RETRACT") {
-      if (command.getActuator() == 0) {
-        relays.controlRelays(false);
-        Serial.println ("RETRACTING ALL");
-      } else {
-        relays.controlSingleActuator(command.getActuator());
-        Serial.print ("RETRACTING: ");
-        Serial.println (command.getActuator());
+    trace<TraceId::COMMAND>(static_cast<uint8_t>(command.getOpcode()), command.getActuator());
+    switch (command.getOpcode()) {
+      case Opcode::EXTEND:
+      case Opcode::RETRACT: {
+        bool isExtend = command.getOpcode() == Opcode::EXTEND;
+        if (command.appliesToAll()) {
+          relays.controlRelays(isExtend);
+        } else {
+          int relayIndex = MegaCommand::relayIndexFor(command.getActuator(),
+                                                      isExtend ? Mode::EXTENDING : Mode::RETRACTING);
+          if (relayIndex < 0) {
+            return;
+          }
+          relays.controlSingleActuator(relayIndex);
+        }
+        leds.setFullBrightness(true, isExtend);
+        break;
       }
-      leds.setFullBrightness(true, false);
+      case Opcode::PAUSE:
+        if (command.appliesToAll()) {
+          relays.pauseAll();
+        } else {
+          // either relay of the actuator may be the one running.
+          relays.pauseSingleActuator(MegaCommand::relayIndexFor(command.getActuator(), Mode::EXTENDING));
+          relays.pauseSingleActuator(MegaCommand::relayIndexFor(command.getActuator(), Mode::RETRACTING));
+        }
+        if (!relays.anyActive()) {
+          leds.setFullBrightness(false, false);
+        }
+        break;
+      case Opcode::SNAPSHOT:
+        if (reporter != nullptr) {
+          reporter->requestSnapshot();
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Executes every command waiting in the receiver's queue.
+  void processCommands(MegaCommandQueue& queue) {
+    MegaCommand command;
+    while (queue.pop(command)) {
+      executeCommand(command);
     }
   }
 
@@ -45,5 +76,6 @@ private:
   MegaRelayControl
 & relays;
   MegaLEDControl& leds;
+  ActuatorReporter* reporter;
 };
 } // namespace ActuatorsController
\ No newline at end of file
@@ -3,41 +3,135 @@
 //
 #pragma once
 #include <Arduino.h>
+#include "inputmapping.h"
+#include "link/LinkCommands.h"
 
 namespace ActuatorsController {
 
+// A command for the controller: opcode, typed argument and the sender's sequence number.
+// Commands arrive either as binary COMMAND frames from the ESP32 or as console text with the
+// syntax "[#<sequence>] <WORD> [<argument>]", e.g. "#12 EXTEND 2" or "RETRACT ALL".
+// Text commands without a sequence number are given sequence 0.
 class MegaCommand {
 public:
-  MegaCommand(const String& rawCommand) {
-    parseCommand(rawCommand);
+  MegaCommand() : opcode(Opcode::NONE), actuator(ALL_ACTUATORS), sequence(0), status(CommandStatus::MALFORMED) {}
+
+  // Parses a console command line.
+  explicit MegaCommand(const char* rawCommand) : MegaCommand() {
+    status = parseCommand(rawCommand);
+  }
+
+  // Validates a command received in a binary COMMAND frame.
+  MegaCommand(Opcode opcode, uint8_t actuator, uint16_t sequence)
+    : opcode(opcode), actuator(actuator), sequence(sequence), status(CommandStatus::OK) {
+    const CommandSpec* spec = findCommand(opcode);
+    if (spec == nullptr) {
+      this->opcode = Opcode::NONE;
+      status = CommandStatus::UNKNOWN_COMMAND;
+    } else if (spec->argument == ArgumentKind::ACTUATOR_OR_ALL && actuator > TOTAL_ACTUATORS) {
+      status = CommandStatus::BAD_ARGUMENT;
+    }
   }
 
-  const String& getAction() const {
-    return action;
+  Opcode getOpcode() const {
+    return opcode;
   }
 
-  int getActuator() const {
+  // 1-based actuator number, or ALL_ACTUATORS.
+  uint8_t getActuator() const {
     return actuator;
   }
 
+  bool appliesToAll() const {
+    return actuator == ALL_ACTUATORS;
+  }
+
+  uint16_t getSequence() const {
+    return sequence;
+  }
+
+  CommandStatus getStatus() const {
+    return status;
+  }
+
+  bool isValid() const {
+    return status == CommandStatus::OK;
+  }
+
+  // Command word for the opcode, or "NONE".
+  const char* getWord() const {
+    const CommandSpec* spec = findCommand(opcode);
+    return spec ? spec->word : "NONE";
+  }
+
+  // Relay index driving the given actuator number in the given direction, looked up
+  // from inputMappings.  Returns -1 if there is no such relay.
+  static int relayIndexFor(uint8_t actuatorNumber, Mode mode) {
+    uint8_t seen = 0;
+    for (int i = 0; i < MAX_RELAY_PINS; i++) {
+      if (inputMappings[i].mode == mode && ++seen == actuatorNumber) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
 private:
-  String action;
-  int actuator;
-
-  void parseCommand(const String& rawCommand) {
-    int spaceIndex = rawCommand.indexOf(' ');
-    if (spaceIndex > 0) {
-      action = rawCommand.substring(0, spaceIndex);
-      String actuatorStr = rawCommand.substring(spaceIndex + 1);
-      if (actuatorStr == "ALL") {
-        actuator = -1;
+  Opcode opcode;
+  uint8_t actuator;
+  uint16_t sequence;
+  CommandStatus status;
+
+  static const char* skipSpaces(const char* text) {
+    while (*text == ' ') {
+      text++;
+    }
+    return text;
+  }
+
+  // Parses an unsigned decimal number ending at a space or the end of the text.
+  static bool parseNumber(const char*& text, unsigned long& value) {
+    char* end;
+    value = strtoul(text, &end, 10);
+    if (end == text || (*end != ' ' && *end != '\0')) {
+      return false;
+    }
+    text = end;
+    return true;
+  }
+
+  CommandStatus parseCommand(const char* rawCommand) {
+    const char* cursor = skipSpaces(rawCommand);
+    unsigned long number;
+    if (*cursor == '#') {
+      cursor++;
+      if (!parseNumber(cursor, number) || number > 0xFFFF) {
+        return CommandStatus::MALFORMED;
+      }
+      sequence = static_cast<uint16_t>(number);
+      cursor = skipSpaces(cursor);
+    }
+    // look the command word up in the dictionary.
+    const char* wordEnd = strchr(cursor, ' ');
+    size_t wordLength = wordEnd ? static_cast<size_t>(wordEnd - cursor) : strlen(cursor);
+    const CommandSpec* spec = findCommand(cursor, wordLength);
+    if (spec == nullptr) {
+      return CommandStatus::UNKNOWN_COMMAND;
+    }
+    opcode = spec->opcode;
+    cursor = skipSpaces(cursor + wordLength);
+    if (spec->argument == ArgumentKind::ACTUATOR_OR_ALL) {
+      if (strncmp(cursor, "ALL", 3) == 0 && (cursor[3] == ' ' || cursor[3] == '\0')) {
+        actuator = ALL_ACTUATORS;
+        cursor += 3;
+      } else if (parseNumber(cursor, number) && number >= 1 && number <= TOTAL_ACTUATORS) {
+        actuator = static_cast<uint8_t>(number);
       } else {
-        actuator = actuatorStr.toInt() - 1;
-        if (action == "RETRACT") {
-          actuator = actuator + (MAX_RELAY_PINS / 2);
-        }
+        return CommandStatus::BAD_ARGUMENT;
       }
     }
+    // nothing may follow the last argument.
+    return *skipSpaces(cursor) == '\0' ? CommandStatus::OK : CommandStatus::BAD_ARGUMENT;
   }
 };
 } // namespace ActuatorsController
@@ -0,0 +1,148 @@
+//
+// MegaCommandReceiver.h
+// Description: Incremental, non-blocking reader for newline-terminated console commands.
+//
+#pragma once
+#include <Arduino.h>
+#include <ctype.h>
+#include "MegaCommand.h"
+
+namespace ActuatorsController {
+
+// Small fixed-capacity FIFO of parsed commands waiting to be executed.
+class MegaCommandQueue {
+public:
+  static const uint8_t CAPACITY = 4;
+
+  MegaCommandQueue() : head(0), count(0) {}
+
+  // Returns false if the queue is full and the command was not stored.
+  bool push(const MegaCommand& command) {
+    if (count == CAPACITY) {
+      return false;
+    }
+    commands[(head + count) % CAPACITY] = command;
+    count++;
+    return true;
+  }
+
+  bool pop(MegaCommand& command) {
+    if (count == 0) {
+      return false;
+    }
+    command = commands[head];
+    head = (head + 1) % CAPACITY;
+    count--;
+    return true;
+  }
+
+  bool isEmpty() const {
+    return count == 0;
+  }
+
+private:
+  MegaCommand commands[CAPACITY];
+  uint8_t head;
+  uint8_t count;
+};
+
+// Assembles bytes from the input stream into a fixed line buffer a few at a time, so a
+// partial line never blocks loop().  Each complete line is parsed and pushed onto the queue,
+// and answered with a line such as "ACK 12 OK" or "NAK 12 BAD_ARGUMENT"; a NAKed command
+// was not queued.  Used for the USB console; the ESP32 sends binary frames instead.
+class MegaCommandReceiver {
+public:
+  // Longest command line accepted, excluding the newline.
+  static const uint8_t LINE_SIZE = 48;
+  // Upper bound on bytes consumed per poll() so a burst cannot starve the control loop.
+  static const uint8_t MAX_BYTES_PER_POLL = 64;
+
+  MegaCommandReceiver(Stream& input, MegaCommandQueue& queue, Print& replies)
+    : input(input), queue(queue), replies(replies), lineLength(0), discarding(false),
+      receivedCount(0), overflowCount(0), malformedCount(0) {}
+
+  // Call every loop(): consumes whatever has arrived without waiting for more.
+  void poll() {
+    uint8_t budget = MAX_BYTES_PER_POLL;
+    while (budget-- > 0 && input.available() > 0) {
+      char c = static_cast<char>(input.read());
+      if (c == '\n') {
+        completeLine();
+      } else if (discarding) {
+        // drop the rest of an overlong line.
+      } else if (lineLength < LINE_SIZE) {
+        line[lineLength++] = c;
+      } else {
+        discarding = true;
+      }
+    }
+  }
+
+  // Lines parsed into a command and queued.
+  uint16_t getReceivedCount() const {
+    return receivedCount;
+  }
+
+  // Valid commands dropped because the queue was full.
+  uint16_t getOverflowCount() const {
+    return overflowCount;
+  }
+
+  // Lines dropped because they were too long or could not be parsed.
+  uint16_t getMalformedCount() const {
+    return malformedCount;
+  }
+
+private:
+  Stream& input;
+  MegaCommandQueue& queue;
+  Print& replies;
+  char line[LINE_SIZE + 1];
+  uint8_t lineLength;
+  bool discarding;
+  uint16_t receivedCount;
+  uint16_t overflowCount;
+  uint16_t malformedCount;
+
+  void completeLine() {
+    if (discarding) {
+      malformedCount++;
+      acknowledge(0, CommandStatus::MALFORMED);
+    } else {
+      // trim trailing carriage returns and whitespace, then leading whitespace.
+      while (lineLength > 0 && isspace(static_cast<unsigned char>(line[lineLength - 1]))) {
+        lineLength--;
+      }
+      line[lineLength] = '\0';
+      const char* start = line;
+      while (isspace(static_cast<unsigned char>(*start))) {
+        start++;
+      }
+      if (*start != '\0') {
+        MegaCommand command(start);
+        CommandStatus status = command.getStatus();
+        if (!command.isValid()) {
+          malformedCount++;
+        } else if (queue.push(command)) {
+          receivedCount++;
+        } else {
+          overflowCount++;
+          status = CommandStatus::QUEUE_FULL;
+        }
+        acknowledge(command.getSequence(), status);
+      }
+    }
+    lineLength = 0;
+    discarding = false;
+  }
+
+  // Replies with an ACK (status OK) or NAK line for a command sequence number.
+  void acknowledge(uint16_t sequence, CommandStatus status) {
+    replies.print(status == CommandStatus::OK ? "ACK " : "NAK ");
+    replies.print(sequence);
+    replies.print(' ');
+    replies.println(commandStatusName(status));
+  }
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,230 @@
+//
+// MegaLink.h
+// Description: Sends binary link frames to the ESP32 through the transmit scheduler.
+//
+#pragma once
+#include <Arduino.h>
+#include "link/LinkCommands.h"
+#include "link/LinkHeartbeat.h"
+#include "link/LinkSchema.h"
+#include "MegaTrace.h"
+#include "MegaTxScheduler.h"
+
+namespace ActuatorsController {
+
+// One bit per relay index; used to batch several actuators into a single report frame.
+typedef uint16_t ActuatorMask;
+
+// Queues frames on the link.  STATUS frames carry only the fields that changed, so the
+// ESP32 must apply them in the order they were built: a frame for some actuators is queued
+// no higher than the lowest priority class still holding an earlier frame for any of them,
+// and never overtakes it.
+//
+// Frames wait in the queue unencoded.  The link is the queue's framer: it stamps each frame
+// with the next sequence number and encodes it only when the frame is picked for sending, so
+// the numbers on the wire are consecutive however the priority lanes reorder frames, and a
+// frame superseded in the queue never uses one up.  The ESP32 sees a gap only when a frame
+// was lost on the wire.
+//
+// The actuators carried by the last RESEND_HISTORY frames are remembered, so a RESYNC
+// request for missing sequence numbers is turned into keyframes for just those actuators.
+class MegaLink : public TxFramer {
+public:
+    // Frames whose contents can still be looked up for a RESYNC request.
+    static const uint8_t RESEND_HISTORY = 16;
+
+    // node is this Mega's address; every frame it sends carries it.
+    MegaLink(MegaTxScheduler &linkTx, uint8_t node) :
+        linkTx(linkTx), node(node), nextSequence(0), lastFrameSize(0), wire(), history(), resyncMask(0), resyncCount(0),
+        repairCount(0) {
+        linkTx.setFramer(this);
+    }
+
+    // Returns false if the frame could not be encoded or the queue had no room for it.
+    // actuators are the relays whose state the frame reports, for keeping their frames in
+    // order and for repairing the frame if it is lost.
+    bool send(LinkFrameWriter &frame, TxPriority priority, uint8_t mergeKey = MegaTxScheduler::NO_MERGE,
+              ActuatorMask actuators = 0) {
+        if (frame.hasOverflowed()) {
+            return false;
+        }
+        if (actuators != 0) {
+            priority = linkTx.lowestHolding(priority, actuators);
+        }
+        frame.setNode(node);
+        if (!linkTx.enqueue(frame.data(), frame.size(), priority, mergeKey, actuators)) {
+            return false;
+        }
+        lastFrameSize = frame.wireSize();
+        return true;
+    }
+
+    // Numbers and encodes a queued frame as the scheduler starts sending it.
+    const uint8_t *frameRecord(const uint8_t *part1, uint16_t length1, const uint8_t *part2, uint16_t length2,
+                               uint8_t mergeKey, uint16_t tag, uint16_t &wireLength) override {
+        LinkFrameWriter frame(part1, length1, part2, length2);
+        uint16_t sequence = nextSequence;
+        wireLength = static_cast<uint16_t>(encode(frame, wire, sizeof(wire)));
+        if (wireLength == 0) {
+            return nullptr;
+        }
+        markSent(mergeKey, tag);
+        if (frame.getType() == FrameType::STATUS && mergeKey == MegaTxScheduler::NO_MERGE) {
+            trace<TraceId::STATUS_SENT>(sequence, tag);
+        }
+        return wire;
+    }
+
+    // Stamps the node and the next sequence number and encodes the frame, for a caller that
+    // writes it to the port itself.  Call markSent() once it is written.
+    size_t encode(LinkFrameWriter &frame, uint8_t *out, size_t capacity) {
+        frame.setNode(node);
+        return frame.encode(nextSequence, out, capacity);
+    }
+
+    // Records the frame last encoded as sent and moves on to the next sequence number.
+    void markSent(uint8_t mergeKey = MegaTxScheduler::NO_MERGE, ActuatorMask actuators = 0) {
+        SentFrame &sent = history[nextSequence % RESEND_HISTORY];
+        sent.sequence = nextSequence;
+        sent.actuators = actuators;
+        sent.mergeKey = mergeKey;
+        sent.replaced = false;
+        nextSequence++;
+    }
+
+    uint8_t getNode() const {
+        return node;
+    }
+
+    // Drops queued frames with mergeKey in a priority class, for a caller that has just queued
+    // a frame carrying everything they did.  Those already sent need no repair if lost.
+    void supersede(TxPriority priority, uint8_t mergeKey) {
+        linkTx.supersede(priority, mergeKey);
+        for (uint8_t i = 0; i < RESEND_HISTORY; i++) {
+            if (history[i].mergeKey == mergeKey) {
+                history[i].replaced = true;
+            }
+        }
+    }
+
+    // Acknowledges a COMMAND frame; any status but OK is a NAK.
+    bool sendAck(uint16_t commandSequence, CommandStatus status) {
+        AckMessage ack;
+        ack.sequence = commandSequence;
+        ack.status = static_cast<uint8_t>(status);
+        LinkFrameWriter frame(FrameType::ACK);
+        encodeMessage(frame, ack);
+        return send(frame, TxPriority::STATE);
+    }
+
+    // Heartbeats go ahead of position updates so a busy link is not mistaken for a dead one.
+    bool sendHeartbeat(LinkHeartbeat &heartbeat, unsigned long now) {
+        HeartbeatMessage message;
+        heartbeat.fill(message, now);
+        LinkFrameWriter frame(FrameType::HEARTBEAT);
+        encodeMessage(frame, message);
+        return send(frame, TxPriority::STATE);
+    }
+
+    // Works out which actuators the frames firstSequence .. firstSequence + count - 1 carried.
+    // A position update that a later frame for the same actuator has replaced needs no
+    // repair.  If a frame is too old to be in the history every actuator is repaired.
+    void handleResync(uint16_t firstSequence, uint8_t count) {
+        ActuatorMask repair = 0;
+        for (uint8_t offset = 0; offset < count; offset++) {
+            const SentFrame *sent = findSent(firstSequence + offset);
+            if (sent == nullptr) {
+                repair = static_cast<ActuatorMask>(~0U);
+                break;
+            }
+            if (sent->mergeKey == MegaTxScheduler::NO_MERGE || !isSuperseded(*sent)) {
+                repair |= sent->actuators;
+            }
+        }
+        resyncCount++;
+        if (repair != 0) {
+            repairCount++;
+        }
+        requestRepair(repair);
+    }
+
+    // Schedules keyframes for the given actuators, e.g. for an ESP32 that just restarted.
+    void requestRepair(ActuatorMask actuators) {
+        resyncMask |= actuators;
+    }
+
+    // Actuators to be sent again as keyframes; clears the request.
+    ActuatorMask takeResyncRequests() {
+        ActuatorMask requested = resyncMask;
+        resyncMask = 0;
+        return requested;
+    }
+
+    // RESYNC requests received, and those that led to actuators being sent again.
+    uint16_t getResyncCount() const {
+        return resyncCount;
+    }
+
+    uint16_t getRepairCount() const {
+        return repairCount;
+    }
+
+    // Bytes the most recently queued frame will occupy on the wire.
+    uint16_t getLastFrameSize() const {
+        return lastFrameSize;
+    }
+
+    // Bytes waiting to be sent in a priority class.
+    uint16_t getQueuedBytes(TxPriority priority) const {
+        return linkTx.getQueuedBytes(priority);
+    }
+
+    // Sequence number the next frame put on the wire will carry.
+    uint16_t getNextSequence() const {
+        return nextSequence;
+    }
+
+private:
+    struct SentFrame {
+        uint16_t sequence;
+        ActuatorMask actuators;
+        uint8_t mergeKey;
+        bool replaced; // a later frame of another kind carried everything this one did
+    };
+
+    MegaTxScheduler &linkTx;
+    uint8_t node;
+    uint16_t nextSequence;
+    uint16_t lastFrameSize;
+    // The frame being written to the port, numbered and encoded.
+    uint8_t wire[LINK_MAX_ENCODED_SIZE];
+    SentFrame history[RESEND_HISTORY];
+    ActuatorMask resyncMask;
+    uint16_t resyncCount;
+    uint16_t repairCount;
+
+    // The history entry of a sent frame, or nullptr if it has been overwritten or not sent yet.
+    const SentFrame *findSent(uint16_t sequence) const {
+        uint16_t age = nextSequence - sequence;
+        if (age == 0 || age > RESEND_HISTORY) {
+            return nullptr;
+        }
+        return &history[sequence % RESEND_HISTORY];
+    }
+
+    // True if a later frame in the history carries the same merge key, or one that replaced it.
+    bool isSuperseded(const SentFrame &sent) const {
+        if (sent.replaced) {
+            return true;
+        }
+        for (uint16_t sequence = sent.sequence + 1; sequence != nextSequence; sequence++) {
+            const SentFrame *later = findSent(sequence);
+            if (later != nullptr && later->mergeKey == sent.mergeKey) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,164 @@
+//
+// MegaLinkBus.h
+// Description: Transmit side of the Mega's link, either free running or in RS-485 bus turns.
+//
+#pragma once
+#include <Arduino.h>
+#include "MegaLink.h"
+#include "MegaTxScheduler.h"
+
+namespace ActuatorsController {
+
+// On a direct Serial2 link the transmit queue is serviced every loop.  On an RS-485 bus
+// shared with other Megas (dePin >= 0) the transceiver's driver stays off and the queue
+// waits until the ESP32 polls this node.  The turn then sends up to LINK_BUS_TURN_BYTES of
+// queued frames, finishes with an END frame and releases the bus, so the ESP32 can move on
+// to the next node without waiting for its poll timeout.
+//
+// Nothing here waits on the UART.  END is written once the UART has room for it, and the
+// driver is released on a later loop() once END's last byte has had time to leave the
+// shift register.  A turn still running after MAX_TURN_MS drops the rest of its frame in
+// flight, so END normally reaches the ESP32 well within LINK_BUS_TURN_TIMEOUT_MS.
+class MegaLinkBus {
+public:
+    // A turn that cannot get its bytes out in this long is cut short.
+    static const unsigned long MAX_TURN_MS = 30;
+    // One character at the slowest link rate, rounded up.
+    static const unsigned long CHAR_MICROS = 10000000UL / LINK_BAUD_RATES[0] + 1;
+
+    // dePin drives the transceiver's DE and /RE pins; -1 for a direct link.
+    MegaLinkBus(HardwareSerial &port, MegaTxScheduler &linkTx, MegaLink &link, int8_t dePin) :
+        port(port), linkTx(linkTx), link(link), dePin(dePin), phase(OFF), txIdle(0), turnStart(0), turnBytes(0),
+        releaseStart(0), releaseWait(0), turnCount(0), cutShortCount(0) {}
+
+    // Call from setup(), after the port is started.
+    void begin() {
+        if (isMultidrop()) {
+            pinMode(dePin, OUTPUT);
+            digitalWrite(dePin, LOW);
+            txIdle = port.availableForWrite();
+        }
+    }
+
+    bool isMultidrop() const {
+        return dePin >= 0;
+    }
+
+    // Called when a POLL frame for this node arrives.
+    void grantTurn() {
+        if (!isMultidrop() || phase != OFF) {
+            return;
+        }
+        phase = SENDING;
+        turnStart = millis();
+        turnBytes = 0;
+        turnCount++;
+        digitalWrite(dePin, HIGH);
+    }
+
+    // Call every loop() in place of servicing the transmit queue directly.
+    void service() {
+        if (!isMultidrop()) {
+            linkTx.service();
+            return;
+        }
+        if (phase == SENDING) {
+            serviceTurn();
+        }
+        if (phase == ENDING) {
+            writeEnd();
+        }
+        if (phase == RELEASING) {
+            releaseDriver();
+        }
+    }
+
+    // Turns granted, and turns that ran past MAX_TURN_MS.
+    uint16_t getTurnCount() const {
+        return turnCount;
+    }
+
+    uint16_t getCutShortCount() const {
+        return cutShortCount;
+    }
+
+private:
+    enum TurnPhase : uint8_t { OFF, SENDING, ENDING, RELEASING };
+
+    HardwareSerial &port;
+    MegaTxScheduler &linkTx;
+    MegaLink &link;
+    int8_t dePin;
+    TurnPhase phase;
+    // What availableForWrite() reports with nothing left to send, measured in begin().
+    int txIdle;
+    unsigned long turnStart;
+    uint16_t turnBytes;
+    unsigned long releaseStart;
+    unsigned long releaseWait;
+    uint16_t turnCount;
+    uint16_t cutShortCount;
+
+    void serviceTurn() {
+        uint16_t limit = turnBytes < LINK_BUS_TURN_BYTES ? LINK_BUS_TURN_BYTES - turnBytes : 0;
+        turnBytes += linkTx.service(limit);
+        bool overdue = millis() - turnStart >= MAX_TURN_MS;
+        if (linkTx.isFrameInFlight() && !overdue) {
+            return;
+        }
+        if (turnBytes >= LINK_BUS_TURN_BYTES || linkTx.isIdle() || overdue) {
+            if (overdue) {
+                cutShortCount++;
+                if (linkTx.isFrameInFlight()) {
+                    // the delimiter ends the cut frame, which then fails its CRC.
+                    linkTx.abandonFrame();
+                    linkTx.requestDelimiter();
+                }
+            }
+            phase = ENDING;
+        }
+    }
+
+    // END goes straight to the UART rather than through the queue, once there is room for
+    // it and any delimiter still owed, so the write does not block.  If END could no longer
+    // be on the wire before the ESP32 gives up on the turn, the driver is released without
+    // it, since the ESP32 may be polling the next node by then.
+    void writeEnd() {
+        LinkFrameWriter end(FrameType::END);
+        size_t length = end.wireSize();
+        if (port.availableForWrite() < static_cast<int>(length) + 1) {
+            return;
+        }
+        linkTx.service(0);
+        // everything queued goes out at the link rate, plus what the UART itself holds.
+        int queued = txIdle - port.availableForWrite();
+        unsigned long sendMicros = (static_cast<unsigned long>(queued > 0 ? queued : 0) + length + 2) * CHAR_MICROS;
+        if ((millis() - turnStart) * 1000UL + sendMicros >= LINK_BUS_TURN_TIMEOUT_MS * 1000UL) {
+            // what is still in the UART is lost, so the next turn starts with a delimiter.
+            linkTx.requestDelimiter();
+            digitalWrite(dePin, LOW);
+            phase = OFF;
+            return;
+        }
+        uint8_t encoded[LINK_MAX_ENCODED_SIZE];
+        length = link.encode(end, encoded, sizeof(encoded));
+        if (length > 0) {
+            port.write(encoded, length);
+            link.markSent();
+        }
+        releaseStart = micros();
+        releaseWait = sendMicros;
+        phase = RELEASING;
+    }
+
+    // The driver is only released once END's last byte is on the wire.
+    void releaseDriver() {
+        if (port.availableForWrite() < txIdle || micros() - releaseStart < releaseWait) {
+            return;
+        }
+        digitalWrite(dePin, LOW);
+        phase = OFF;
+    }
+};
+
+} // namespace ActuatorsController
@@ -0,0 +1,130 @@
+//
+// MegaLinkRate.h
+// Description: Mega side of the link baud rate negotiation led by the ESP32.
+//
+#pragma once
+#include <Arduino.h>
+#include "link/LinkHeartbeat.h"
+#include "link/LinkSchema.h"
+#include "MegaLink.h"
+#include "MegaTrace.h"
+
+namespace ActuatorsController {
+
+// Follows the ESP32's BAUD frames.  TRY switches the UART as soon as no frame is part way
+// out, and PROBE frames are echoed so the ESP32 can check the pattern; unless KEEP arrives
+// within TRY_TIMEOUT_MS of the switch the previous rate is restored.  If nothing valid is heard for FALLBACK_MS at a raised rate,
+// e.g. because the ESP32 restarted or gave up on the rate, the link drops back to the
+// starting rate where the ESP32 negotiates again.
+class MegaLinkRate {
+public:
+    static const unsigned long TRY_TIMEOUT_MS = 500;
+    static const unsigned long FALLBACK_MS = 1500;
+
+    MegaLinkRate(HardwareSerial &port, MegaTxScheduler &linkTx, MegaLink &link) :
+        port(port), linkTx(linkTx), link(link), rateIndex(0), pendingIndex(NO_SWITCH), keptIndex(0), trying(false),
+        tryStart(0), switchCount(0), fallbackCount(0) {}
+
+    // Handles BAUD and PROBE frames; returns false for any other frame type.
+    bool handleFrame(const LinkFrame &frame) {
+        LinkPayloadReader payload(frame.payload, frame.payloadLength);
+        if (frame.type == FrameType::PROBE) {
+            ProbeMessage probe;
+            if (decodeMessage(payload, probe)) {
+                LinkFrameWriter echo(FrameType::PROBE);
+                encodeMessage(echo, probe);
+                link.send(echo, TxPriority::STATE);
+            }
+            return true;
+        }
+        if (frame.type != FrameType::BAUD) {
+            return false;
+        }
+        BaudMessage baud;
+        if (!decodeMessage(payload, baud) || baud.rateIndex >= LINK_BAUD_RATE_COUNT) {
+            return true;
+        }
+        if (baud.action == static_cast<uint8_t>(BaudAction::TRY)) {
+            trying = true;
+            tryStart = millis();
+            switchTo(baud.rateIndex);
+        } else if (baud.action == static_cast<uint8_t>(BaudAction::KEEP) && baud.rateIndex == rateIndex &&
+                   pendingIndex == NO_SWITCH) {
+            trying = false;
+            keptIndex = rateIndex;
+            trace<TraceId::LINK_RATE_KEPT>(LINK_BAUD_RATES[rateIndex]);
+        }
+        return true;
+    }
+
+    // Call every loop() with the link heartbeat, which knows when the ESP32 was last heard.
+    void update(const LinkHeartbeat &heartbeat) {
+        unsigned long now = millis();
+        if (pendingIndex != NO_SWITCH && !linkTx.isFrameInFlight()) {
+            applySwitch(now);
+        }
+        if (trying && pendingIndex == NO_SWITCH && now - tryStart >= TRY_TIMEOUT_MS) {
+            trying = false;
+            switchTo(keptIndex);
+        }
+        if (rateIndex != 0 && pendingIndex != 0 && !heartbeat.heardWithin(now, FALLBACK_MS)) {
+            trying = false;
+            keptIndex = 0;
+            fallbackCount++;
+            switchTo(0);
+        }
+    }
+
+    // The rate the UART runs at; a requested change waits for the frame in flight.
+    uint32_t getBaudRate() const {
+        return LINK_BAUD_RATES[rateIndex];
+    }
+
+    // Rate changes, and drops to the starting rate after the ESP32 went silent.
+    uint16_t getSwitchCount() const {
+        return switchCount;
+    }
+
+    uint16_t getFallbackCount() const {
+        return fallbackCount;
+    }
+
+private:
+    static const uint8_t NO_SWITCH = 0xFF;
+
+    HardwareSerial &port;
+    MegaTxScheduler &linkTx;
+    MegaLink &link;
+    uint8_t rateIndex;
+    uint8_t pendingIndex; // rate to switch to once no frame is in flight, or NO_SWITCH
+    uint8_t keptIndex;
+    bool trying;
+    unsigned long tryStart;
+    uint16_t switchCount;
+    uint16_t fallbackCount;
+
+    // Asks for a rate change; update() makes it between two frames, so none is cut in half.
+    void switchTo(uint8_t index) {
+        pendingIndex = index == rateIndex ? NO_SWITCH : index;
+        if (pendingIndex != NO_SWITCH && !linkTx.isFrameInFlight()) {
+            applySwitch(millis());
+        }
+    }
+
+    // Bytes still in the UART at the old rate are sent first; frames in the transmit queue
+    // simply go out at the new one.  The scheduler puts a lone delimiter ahead of them to
+    // end whatever the ESP32 received half of during the change, so the first frame at the
+    // new rate decodes cleanly.  A trial's timeout runs from here.
+    void applySwitch(unsigned long now) {
+        port.flush();
+        port.begin(LINK_BAUD_RATES[pendingIndex]);
+        linkTx.requestDelimiter();
+        rateIndex = pendingIndex;
+        pendingIndex = NO_SWITCH;
+        tryStart = now;
+        switchCount++;
+        trace<TraceId::LINK_RATE>(LINK_BAUD_RATES[rateIndex]);
+    }
+};
+
+} // namespace ActuatorsController
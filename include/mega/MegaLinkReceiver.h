@@ -0,0 +1,176 @@
+//
+// MegaLinkReceiver.h
+// Description: Non-blocking reader for binary COMMAND frames from the ESP32.
+//
+#pragma once
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "link/LinkHeartbeat.h"
+#include "link/LinkSchema.h"
+#include "MegaCommand.h"
+#include "MegaCommandReceiver.h"
+#include "MegaLink.h"
+#include "MegaLinkBus.h"
+#include "MegaLinkRate.h"
+#include "MegaTrace.h"
+
+namespace ActuatorsController {
+
+// Feeds bytes from the ESP32 link into a frame decoder a few at a time.  Each COMMAND frame
+// is validated, pushed onto the command queue and answered with an ACK frame carrying the
+// command's sequence number and status; a status other than OK is a NAK.  RESYNC frames are
+// handed to the link, which schedules the lost actuator states to be sent again.
+// The receiver also answers the ESP32's heartbeats with its own; when an ESP32 is heard from
+// for the first time since it booted, every actuator is scheduled to be sent in full.
+// Frames addressed to other nodes on a shared bus are ignored.
+class MegaLinkReceiver {
+public:
+    // Upper bound on bytes consumed per poll() so a burst cannot starve the control loop.
+    static const uint8_t MAX_BYTES_PER_POLL = 64;
+    // EEPROM address of the restart counter used as the Mega's boot ID.
+    static const int BOOT_ID_EEPROM_ADDRESS = 0;
+
+    MegaLinkReceiver(Stream &input, MegaCommandQueue &queue, MegaLink &link, uint16_t bootId) :
+        input(input), queue(queue), link(link), heartbeat(bootId), rateControl(nullptr), bus(nullptr),
+        receivedCount(0), overflowCount(0), rejectedCount(0), unacknowledgedCount(0) {}
+
+    // Hands POLL frames for this node to the bus; without it they are ignored.
+    void attachBus(MegaLinkBus &linkBus) {
+        bus = &linkBus;
+    }
+
+    // Lets the ESP32 raise the baud rate; without it BAUD and PROBE frames are ignored.
+    void attachRateControl(MegaLinkRate &linkRate) {
+        rateControl = &linkRate;
+    }
+
+    // Increments and returns the restart counter kept in EEPROM, so every boot of the Mega
+    // carries a different boot ID.  Call once at start-up.
+    static uint16_t nextBootId() {
+        uint16_t bootId = EEPROM.read(BOOT_ID_EEPROM_ADDRESS) |
+            (static_cast<uint16_t>(EEPROM.read(BOOT_ID_EEPROM_ADDRESS + 1)) << 8);
+        bootId++;
+        EEPROM.update(BOOT_ID_EEPROM_ADDRESS, static_cast<uint8_t>(bootId & 0xFF));
+        EEPROM.update(BOOT_ID_EEPROM_ADDRESS + 1, static_cast<uint8_t>(bootId >> 8));
+        return bootId;
+    }
+
+    // Call every loop(): consumes whatever has arrived without waiting for more, and sends
+    // a heartbeat when one is due.
+    void poll() {
+        uint8_t budget = MAX_BYTES_PER_POLL;
+        while (budget-- > 0 && input.available() > 0) {
+            if (decoder.feed(static_cast<uint8_t>(input.read()))) {
+                handleFrame(decoder.getFrame());
+            }
+        }
+        unsigned long now = millis();
+        if (heartbeat.isDue(now)) {
+            link.sendHeartbeat(heartbeat, now);
+        }
+        if (rateControl != nullptr) {
+            rateControl->update(heartbeat);
+        }
+    }
+
+    // Liveness of the ESP32 and round trip times of the link.
+    const LinkHeartbeat &getHeartbeat() const {
+        return heartbeat;
+    }
+
+    // Commands validated and queued.
+    uint16_t getReceivedCount() const {
+        return receivedCount;
+    }
+
+    // Valid commands dropped because the queue was full.
+    uint16_t getOverflowCount() const {
+        return overflowCount;
+    }
+
+    // COMMAND frames NAKed for an unknown opcode, bad argument or short payload.
+    uint16_t getRejectedCount() const {
+        return rejectedCount;
+    }
+
+    // ACK frames that could not be queued on the link.
+    uint16_t getUnacknowledgedCount() const {
+        return unacknowledgedCount;
+    }
+
+    // Frame level error counters.
+    const LinkFrameDecoder &getDecoder() const {
+        return decoder;
+    }
+
+private:
+    Stream &input;
+    MegaCommandQueue &queue;
+    MegaLink &link;
+    LinkFrameDecoder decoder;
+    LinkHeartbeat heartbeat;
+    MegaLinkRate *rateControl;
+    MegaLinkBus *bus;
+    uint16_t receivedCount;
+    uint16_t overflowCount;
+    uint16_t rejectedCount;
+    uint16_t unacknowledgedCount;
+
+    void handleFrame(const LinkFrame &frame) {
+        if (frame.node != link.getNode() && frame.node != LINK_NODE_BROADCAST) {
+            return;
+        }
+        LinkPayloadReader payload(frame.payload, frame.payloadLength);
+        heartbeat.noteFrame(millis());
+        if (frame.type == FrameType::POLL) {
+            if (bus != nullptr) {
+                bus->grantTurn();
+            }
+            return;
+        }
+        if (frame.type == FrameType::HEARTBEAT) {
+            HeartbeatMessage message;
+            if (decodeMessage(payload, message) && heartbeat.receive(message, millis())) {
+                // a freshly booted ESP32 knows nothing of the actuators yet.
+                link.requestRepair(static_cast<ActuatorMask>(~0U));
+                trace<TraceId::ESP32_CONNECTED>(message.bootId);
+            }
+            return;
+        }
+        if (rateControl != nullptr && rateControl->handleFrame(frame)) {
+            return;
+        }
+        if (frame.type == FrameType::RESYNC) {
+            ResyncMessage resync;
+            if (decodeMessage(payload, resync)) {
+                link.handleResync(resync.firstSequence, resync.count);
+                trace<TraceId::RESYNC_REQUESTED>(resync.firstSequence, resync.count);
+            }
+            return;
+        }
+        if (frame.type != FrameType::COMMAND) {
+            return;
+        }
+        CommandMessage message;
+        CommandStatus status = CommandStatus::MALFORMED;
+        if (decodeMessage(payload, message)) {
+            MegaCommand command(static_cast<Opcode>(message.opcode), message.actuator, frame.sequence);
+            status = command.getStatus();
+            if (command.isValid() && !queue.push(command)) {
+                status = CommandStatus::QUEUE_FULL;
+            }
+        }
+        if (status == CommandStatus::OK) {
+            receivedCount++;
+        } else if (status == CommandStatus::QUEUE_FULL) {
+            overflowCount++;
+        } else {
+            rejectedCount++;
+        }
+        if (!link.sendAck(frame.sequence, status)) {
+            unacknowledgedCount++;
+        }
+    }
+};
+
+} // namespace ActuatorsController
@@ -6,6 +6,7 @@
 #include <Arduino.h>
 #include "inputmapping.h"
 #include "MegaRelayControl.h"
+#include "MegaTrace.h"
 
 using namespace ActuatorsController;
 
@@ -37,8 +38,7 @@ bool isForceMode() const {
 
 
 void forceOperator (int actuatorIndex) {
-    Serial.print("FORCED OPERATION: ");
-    Serial.println(actuatorIndex);
+    trace<TraceId::FORCE_ONE>(actuatorIndex);
     if (!relayStates[actuatorIndex].isActive) {
         activate(actuatorIndex); //
     }
@@ -48,8 +48,11 @@ void forceOperator (int actuatorIndex) {
 
 // Initiates a forced operation for all actuators.
 void forceOperation(bool isExtend) {
-    Serial.print("FORCED OPERATION (all actuators): ");
-    Serial.println(isExtend ? "EXTENDING" : "RETRACTING");
+    if (isExtend) {
+        trace<TraceId::FORCE_ALL_EXTEND>();
+    } else {
+        trace<TraceId::FORCE_ALL_RETRACT>();
+    }
     forcedActive = true;
     forcedStartTime = millis();
     for (int i = 0; i < MAX_RELAY_PINS; i++) {
@@ -104,10 +107,6 @@ void controlSingleActuator(int actuatorIndex) {
     }
 
 void activate(int actuatorIndex) {
-    Serial.print("Activating actuator. (Pin/Action): ");
-    Serial.print(inputMappings[actuatorIndex].actuatorPin);
-    Serial.print("/");
-    Serial.println((inputMappings[actuatorIndex].mode == Mode::EXTENDING) ? "EXTENDING" : "RETRACTING");
 
        // if this actuator is not active.
         if (!relayStates[actuatorIndex].isActive) {
@@ -126,8 +125,11 @@ void activate(int actuatorIndex) {
                 }
             }
         }
-        Serial.print("Actuator Position: ");
-        Serial.println (relayStates[actuatorIndex].actuatorPosition);
+        if (inputMappings[actuatorIndex].mode == Mode::EXTENDING) {
+            trace<TraceId::ACTIVATE_EXTEND>(inputMappings[actuatorIndex].actuatorPin, relayStates[actuatorIndex].actuatorPosition);
+        } else {
+            trace<TraceId::ACTIVATE_RETRACT>(inputMappings[actuatorIndex].actuatorPin, relayStates[actuatorIndex].actuatorPosition);
+        }
     }
 
 void pauseSingleActuator(int actuatorIndex) {
@@ -135,8 +137,6 @@ void pauseSingleActuator(int actuatorIndex) {
 
     if (relayStates[actuatorIndex].isActive) {
 
-        Serial.print("Pausing Actuator on pin: ");
-        Serial.print(inputMappings[actuatorIndex].actuatorPin);
         // if this is a retracting actuator
         if (inputMappings[actuatorIndex].mode == Mode::RETRACTING)
         {  // when retracting we subtract from the duration.
@@ -149,8 +149,7 @@ void pauseSingleActuator(int actuatorIndex) {
         } else {
             relayStates[actuatorIndex].actuatorPosition = relayStates[actuatorIndex].actuatorPosition + (currentTime - relayStates[actuatorIndex].startTime);
         }
-        Serial.print(" @: ");
-        Serial.println(relayStates[actuatorIndex].actuatorPosition);
+        trace<TraceId::PAUSE_ONE>(inputMappings[actuatorIndex].actuatorPin, relayStates[actuatorIndex].actuatorPosition);
 
         digitalWrite(inputMappings[actuatorIndex].actuatorPin, HIGH);  // Deactivate the relay
         // save this relays changed state, as well as flagging that a state has changed in any relay.
@@ -170,7 +169,7 @@ void pauseSingleActuator(int actuatorIndex) {
 
 
     void pauseAll() {
-        Serial.println ("Pausing all actuators.");
+        trace<TraceId::PAUSE_ALL>();
         for (int i = 0; i < MAX_RELAY_PINS; i++) {
             pauseSingleActuator(i);
         }
@@ -218,27 +217,37 @@ void setRelayChangedState(int relayIndex, bool stateHasChanged) {
     relayStates[relayIndex].stateHasChanged = stateHasChanged;
 }
 
+// Position of an actuator including the travel since it was started; while it is stopped
+// this is the stored actuatorPosition.
+unsigned long livePosition(int actuatorIndex, unsigned long currentTime) const {
+    const RelayState &state = relayStates[actuatorIndex];
+    if (!state.isActive) {
+        return state.actuatorPosition;
+    }
+    unsigned long elapsedTime = currentTime - state.startTime;
+    if (inputMappings[actuatorIndex].mode == Mode::EXTENDING) {
+        return state.actuatorPosition + elapsedTime;
+    }
+    return (state.actuatorPosition < elapsedTime) ? 0UL : state.actuatorPosition - elapsedTime;
+}
+
+unsigned long livePosition(int actuatorIndex) const {
+    return livePosition(actuatorIndex, millis());
+}
+
 void update() {
     unsigned long currentTime = millis();
 
     if (forcedActive && (currentTime - forcedStartTime >= FORCED_DURATION)) {
-        Serial.println("Forced operation expired. Pausing all actuators.");
+        trace<TraceId::FORCE_EXPIRED>();
         forcedActive = false;
         pauseAll();
     }
 
     for (int i = 0; i < MAX_RELAY_PINS; i++) {
         if (relayStates[i].isActive) {
-            // Calculate elapsed time
-            unsigned long elapsedTime = currentTime - relayStates[i].startTime;
             // The new duration is the previous duration + for extend or - for retract the elapsed time.
-            unsigned long newDuration = 0;
-            if (inputMappings[i].mode == Mode::EXTENDING) {
-                newDuration = relayStates[i].actuatorPosition + elapsedTime;
-            } else if (inputMappings[i].mode == Mode::RETRACTING) { // retracting
-                newDuration = (relayStates[i].actuatorPosition < elapsedTime) ? 0UL
-                                  : relayStates[i].actuatorPosition - elapsedTime;
-            }
+            unsigned long newDuration = livePosition(i, currentTime);
             // Check if the relay should be turned off
             // let it keep running if in force mode.
             if (!isForceMode()) {
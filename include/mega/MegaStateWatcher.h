@@ -9,28 +9,144 @@
 
 namespace ActuatorsController {
 
+// Reports state changes as they happen and, while actuators move, streams their positions.
+// Each moving actuator is sent at most once per stream interval, and the whole stream is
+// held to a bytes-per-second budget.  When position frames start queueing up behind other
+// traffic the interval is doubled (up to MAX_STREAM_BACKOFF times) and relaxed again once
+// the queue drains, so a busy link gets fewer, fresher updates instead of a backlog.
 class MegaStateWatcher {
     public:
+        static const unsigned long DEFAULT_STREAM_INTERVAL = 100UL; // ms per moving actuator
+        static const uint16_t DEFAULT_STREAM_BUDGET = 1500;         // bytes per second
+        static const uint8_t MAX_STREAM_BACKOFF = 3;                 // interval up to 8x
+
         // Constructor: pass in references to the relay control and reporter instances
         MegaStateWatcher(MegaRelayControl &relayControl, ActuatorReporter &reporter)
-            : _relayControl(relayControl), _reporter(reporter) { }
+            : _relayControl(relayControl), _reporter(reporter), _reportPending(false),
+              _streamInterval(DEFAULT_STREAM_INTERVAL), _streamBudget(DEFAULT_STREAM_BUDGET),
+              _budgetBytes(DEFAULT_STREAM_BUDGET), _lastBudgetUpdate(millis()), _streamBackoff(0),
+              _streamFrames(0), _streamSkipped(0), _lastStreamTime() { }
+
+        // Time between position updates of each moving actuator; 0 turns streaming off.
+        void setStreamInterval(unsigned long intervalMs) {
+          _streamInterval = intervalMs;
+        }
+
+        // Link bytes per second the position stream may use.
+        void setStreamBudget(uint16_t bytesPerSecond) {
+          _streamBudget = bytesPerSecond;
+          if (_budgetBytes > bytesPerSecond) {
+            _budgetBytes = bytesPerSecond;
+          }
+        }
+
+        // Position frames queued, and due updates skipped for lack of budget or queue space.
+        uint16_t getStreamFrames() const { return _streamFrames; }
+        uint16_t getStreamSkipped() const { return _streamSkipped; }
+        // Current interval multiplier is 1 << backoff.
+        uint8_t getStreamBackoff() const { return _streamBackoff; }
 
         // It checks for any state changes and tells the reporter to send a status report.
+        // Every relay that changed during this tick, and any keyframe that is due, is batched
+        // into a single frame.  If the link queue is full the changes stay pending and are
+        // merged into the next attempt.
         void checkAndReport() {
-          if (_relayControl.getChangedState()) {
-            // iterate through the relays generating a report for each relay which experienced a state change.
+          ActuatorMask keyframes = _reporter.keyframesDue();
+          if (_relayControl.getChangedState() || _reportPending || keyframes) {
+            // collect each relay which experienced a state change into one mask.
+            ActuatorMask changedActuators = keyframes;
             for (int i = 0; i < MAX_RELAY_PINS; i++) {
               if (_relayControl.hasRelayChangedState(i)) {
-                _reporter.sendStatusReport(i);
-                // reset the relay changed state now that we've generated the report.
-                _relayControl.setRelayChangedState(i, false);
+                changedActuators |= ActuatorReporter::maskFor(i);
+              }
+            }
+            _reportPending = !_reporter.sendStatusReport(changedActuators);
+            if (!_reportPending) {
+              // reset the relay changed state now that the report has been queued.
+              for (int i = 0; i < MAX_RELAY_PINS; i++) {
+                if (changedActuators & ActuatorReporter::maskFor(i)) {
+                  _relayControl.setRelayChangedState(i, false);
+                }
               }
             }
           }
+          streamPositions();
         }
     private:
       MegaRelayControl &_relayControl;
       ActuatorReporter &_reporter;
+      // true while a report is waiting for room in the link queue.
+      bool _reportPending;
+      unsigned long _streamInterval;
+      uint16_t _streamBudget;
+      // token bucket: bytes the stream may still send, refilled at _streamBudget per second.
+      uint16_t _budgetBytes;
+      unsigned long _lastBudgetUpdate;
+      uint8_t _streamBackoff;
+      uint16_t _streamFrames;
+      uint16_t _streamSkipped;
+      unsigned long _lastStreamTime[MAX_RELAY_PINS];
+
+      // Wire size of a single-actuator position frame: link header, status header, index,
+      // presence bits and position, CRC, plus COBS overhead and the delimiter.
+      static const uint8_t POSITION_FRAME_SIZE = LINK_HEADER_SIZE + StatusHeaderMessage::WIRE_SIZE + 2
+                                                 + sizeof(uint16_t) + LINK_CRC_SIZE + 2;
+
+      // Sends position updates for moving actuators that are due, within the byte budget.
+      void streamPositions() {
+        unsigned long now = millis();
+        refillBudget(now);
+        if (_streamInterval == 0) {
+          return;
+        }
+        // position frames from an earlier tick still waiting means the link is busy.
+        bool backlogged = _reporter.getLink().getQueuedBytes(TxPriority::PERIODIC) > 0;
+        bool adjusted = false;
+        unsigned long interval = _streamInterval << _streamBackoff;
+        for (int i = 0; i < MAX_RELAY_PINS; i++) {
+          if (!_relayControl.relayStates[i].isActive || now - _lastStreamTime[i] < interval) {
+            continue;
+          }
+          // adapt the rate once per tick with updates due.  When backlogged the new frames
+          // are still sent, replacing the stale ones in the queue.
+          if (!adjusted) {
+            adjusted = true;
+            if (backlogged && _streamBackoff < MAX_STREAM_BACKOFF) {
+              _streamBackoff++;
+            } else if (!backlogged && _streamBackoff > 0 && _budgetBytes >= _streamBudget / 2) {
+              _streamBackoff--;
+            }
+          }
+          uint16_t frameSize;
+          if (_budgetBytes < POSITION_FRAME_SIZE || !_reporter.sendPositionUpdate(i, frameSize)) {
+            _streamSkipped++;
+            return;
+          }
+          _lastStreamTime[i] = now;
+          if (frameSize > 0) {
+            _streamFrames++;
+            _budgetBytes = _budgetBytes > frameSize ? _budgetBytes - frameSize : 0;
+          }
+        }
+      }
+
+      void refillBudget(unsigned long now) {
+        unsigned long elapsed = now - _lastBudgetUpdate;
+        if (elapsed >= 1000UL) {
+          // a full second refills the bucket completely.
+          _budgetBytes = _streamBudget;
+          _lastBudgetUpdate = now;
+          return;
+        }
+        unsigned long refill = elapsed * _streamBudget / 1000UL;
+        if (refill == 0) {
+          return;
+        }
+        // only advance by the time actually converted into bytes, so slow budgets still refill.
+        _lastBudgetUpdate += refill * 1000UL / _streamBudget;
+        unsigned long budget = _budgetBytes + refill;
+        _budgetBytes = budget > _streamBudget ? _streamBudget : static_cast<uint16_t>(budget);
+      }
 };
 
 }  // namespace ActuatorsController
@@ -0,0 +1,146 @@
+//
+// MegaTrace.h
+// Description: Binary trace records for the Mega's console, decoded on the host.
+//
+// Debug messages used to be printed as text, which kept every literal in SRAM and cost a
+// byte on the console per character.  A trace record instead carries only the event's ID,
+// millis() and its arguments in binary; the message text lives in MEGA_TRACE_EVENTS below
+// and never reaches the Mega's memory.  tools/trace_decode.py reads this file for the
+// texts and turns the console stream back into readable lines.
+//
+// Each event is X(NAME, "text") with one placeholder per argument giving its wire type:
+//   {u8} {u16} {u32}  unsigned     {i8} {i16} {i32}  signed
+//   {x8} {x16} {x32}  hex          {op}              command opcode, by name
+// Append new events at the end so older logs still decode, and keep the decoder's copy of
+// this file in step with the firmware that wrote the log.
+#pragma once
+#include <Arduino.h>
+#include "link/LinkFrame.h"
+#include "MegaTxScheduler.h"
+
+namespace ActuatorsController {
+
+#define MEGA_TRACE_EVENTS(X)                                                           \
+    X(SWITCH_PRESSED, "Switch pressed")                                                \
+    X(EXTEND_BUTTON_DOUBLE, "Double-press detected on extend button")                  \
+    X(EXTEND_BUTTON, "State changed to extend")                                        \
+    X(RETRACT_BUTTON_DOUBLE, "Double-press detected on retract button")                \
+    X(RETRACT_BUTTON, "State changed to retract")                                      \
+    X(SWITCH_FORCE, "Force Extend/Retract command detected on switch on pin {u8}")     \
+    X(SWITCH_ACTIVATE, "Activating actuator for switch on pin {u8}")                   \
+    X(SWITCH_PAUSE, "Pausing actuator for switch on pin {u8}")                         \
+    X(FORCE_ONE, "FORCED OPERATION: {u8}")                                             \
+    X(FORCE_ALL_EXTEND, "FORCED OPERATION (all actuators): EXTENDING")                 \
+    X(FORCE_ALL_RETRACT, "FORCED OPERATION (all actuators): RETRACTING")               \
+    X(FORCE_EXPIRED, "Forced operation expired. Pausing all actuators.")               \
+    X(ACTIVATE_EXTEND, "Activating actuator on pin {u8}: EXTENDING, position {u32}")   \
+    X(ACTIVATE_RETRACT, "Activating actuator on pin {u8}: RETRACTING, position {u32}") \
+    X(PAUSE_ONE, "Pausing actuator on pin {u8} @: {u32}")                              \
+    X(PAUSE_ALL, "Pausing all actuators.")                                             \
+    X(COMMAND, "Command: {op}, actuator {u8}")                                         \
+    X(STATUS_FRAME, "Mega status frame {u16}, actuators 0x{x16}, encoded in {u32}us")  \
+    X(ESP32_CONNECTED, "ESP32 connected, boot ID {u16}")                               \
+    X(RESYNC_REQUESTED, "Resync requested for frames from {u16}, count {u8}")          \
+    X(LINK_RATE, "Link rate {u32}")                                                    \
+    X(LINK_RATE_KEPT, "Link rate kept at {u32}")                                       \
+    X(STATUS_QUEUED, "Mega status queued, actuators 0x{x16}, encoded in {u32}us")      \
+    X(STATUS_SENT, "Mega status frame {u16} sent, actuators 0x{x16}")
+
+#define MEGA_TRACE_ID(name, text) name,
+#define MEGA_TRACE_TEXT(name, text) id == TraceId::name ? text:
+
+enum class TraceId : uint8_t { MEGA_TRACE_EVENTS(MEGA_TRACE_ID) COUNT };
+
+// Text of an event.  Only ever called at compile time, so none of these strings end up
+// on the Mega.
+constexpr const char *traceText(TraceId id) {
+    return MEGA_TRACE_EVENTS(MEGA_TRACE_TEXT) "";
+}
+
+// Number of placeholders in an event text.
+constexpr uint8_t traceArgumentCount(const char *text) {
+    return *text == '\0' ? 0 : (*text == '{') + traceArgumentCount(text + 1);
+}
+
+// Wire size of the placeholder whose type starts at type, e.g. "u16}".
+constexpr uint8_t tracePlaceholderSize(const char *type) {
+    return type[0] == 'o' || type[1] == '8' ? 1 : type[1] == '1' ? 2 : 4;
+}
+
+// Wire size of placeholder number n in an event text.
+constexpr uint8_t traceArgumentSize(const char *text, uint8_t n) {
+    return *text == '\0'  ? 0
+           : *text != '{' ? traceArgumentSize(text + 1, n)
+           : n == 0       ? tracePlaceholderSize(text + 1)
+                          : traceArgumentSize(text + 1, n - 1);
+}
+
+// Queues trace records on the console's DEBUG ring, so logging never waits on the UART.  A
+// record is a link frame of type TRACE,
+//   payload [event u8][millis u32][arguments ...]
+// sent after an extra 0x00 so the decoder can tell it from the text lines around it.
+// Records are numbered, and one refused by a full ring still uses up its number, so the
+// decoder reports how many were lost.
+class MegaTrace {
+public:
+    explicit MegaTrace(MegaTxScheduler &console) : console(console), nextSequence(0) {}
+
+    // Starts a record; the caller adds the arguments and calls submit().
+    void begin(LinkFrameWriter &record, TraceId id) {
+        record.putU8(static_cast<uint8_t>(id));
+        record.putU32(static_cast<uint32_t>(millis()));
+    }
+
+    // Writes the low SIZE bytes of value; signed values arrive sign-extended.
+    template <uint8_t SIZE>
+    static void putArgument(LinkFrameWriter &record, uint32_t value) {
+        for (uint8_t i = 0; i < SIZE; i++) {
+            record.putU8(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void submit(LinkFrameWriter &record) {
+        uint8_t encoded[LINK_MAX_ENCODED_SIZE + 1];
+        encoded[0] = 0;
+        size_t length = record.encode(nextSequence++, encoded + 1, sizeof(encoded) - 1);
+        if (length > 0) {
+            console.enqueue(encoded, static_cast<uint16_t>(length + 1), TxPriority::DEBUG);
+        }
+    }
+
+    // Records numbered so far, sent or not.
+    uint16_t getRecordCount() const {
+        return nextSequence;
+    }
+
+private:
+    MegaTxScheduler &console;
+    uint16_t nextSequence;
+};
+
+// Trace output on the console, defined in mega2560_main.cpp.
+extern MegaTrace megaTrace;
+
+template <TraceId ID, uint8_t N>
+inline void traceArguments(LinkFrameWriter &) {}
+
+template <TraceId ID, uint8_t N, typename T, typename... Rest>
+inline void traceArguments(LinkFrameWriter &record, T value, Rest... rest) {
+    // a template argument, so the size is worked out by the compiler and not on the Mega.
+    MegaTrace::putArgument<traceArgumentSize(traceText(ID), N)>(record, static_cast<uint32_t>(value));
+    traceArguments<ID, N + 1>(record, rest...);
+}
+
+// Logs an event, e.g. trace<TraceId::PAUSE_ONE>(pin, position).  The arguments are
+// checked against the event's placeholders at compile time.
+template <TraceId ID, typename... Args>
+inline void trace(Args... args) {
+    static_assert(traceArgumentCount(traceText(ID)) == sizeof...(Args),
+                  "trace arguments do not match the event's placeholders");
+    LinkFrameWriter record(FrameType::TRACE);
+    megaTrace.begin(record, ID);
+    traceArguments<ID, 0>(record, args...);
+    megaTrace.submit(record);
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,432 @@
+//
+// MegaTxScheduler.h
+// Description: Non-blocking, prioritized transmit queue for the Mega's serial ports.
+//
+#pragma once
+#include <Arduino.h>
+
+namespace ActuatorsController {
+
+// Priority classes for outbound traffic, highest first.
+enum class TxPriority : uint8_t {
+    SAFETY,   // forced operations, faults
+    STATE,    // actuator state changes
+    PERIODIC, // position streaming and other refreshable data
+    DEBUG     // console output
+};
+
+// Turns a queued record into the bytes that go on the wire, at the moment the scheduler picks
+// it for sending.  The link numbers its frames here, so they are numbered in the order they
+// are transmitted whatever lane they waited in.
+class TxFramer {
+public:
+    // The record comes in two parts when it wraps around the end of its ring.  Returns the
+    // bytes to write, valid until the next call, and sets wireLength to their count; nullptr
+    // drops the record.
+    virtual const uint8_t *frameRecord(const uint8_t *part1, uint16_t length1, const uint8_t *part2,
+                                       uint16_t length2, uint8_t mergeKey, uint16_t tag, uint16_t &wireLength) = 0;
+
+protected:
+    ~TxFramer() {}
+};
+
+// Holds outbound frames in fixed per-priority rings and feeds the UART only as fast as
+// availableForWrite() allows, so loop() never waits on a full hardware TX buffer.
+//
+// - SAFETY and STATE frames are never dropped once queued; enqueue() refuses them when their
+//   ring is full and the caller keeps the data pending until the next tick.
+// - PERIODIC frames may carry a merge key; a newer frame with the same key supersedes any
+//   queued older one, and the oldest PERIODIC frames are evicted when the ring is full.
+// - DEBUG frames are dropped when their ring is full.
+// A frame that has started transmitting is always completed before the next one is picked.
+// With a framer attached, a record leaves its ring when it is picked and its framed bytes
+// are written from the framer's buffer.
+//
+// Each frame may also carry a tag, a bit mask the caller gives meaning to (the link uses one
+// bit per actuator the frame reports).  lowestHolding() finds the class a frame must be
+// queued in so it cannot overtake an older frame with the same tag bits in a lower class.
+class MegaTxScheduler {
+public:
+    static const uint8_t PRIORITY_COUNT = 4;
+    // Frames queued with NO_MERGE never supersede each other.
+    static const uint8_t NO_MERGE = 0xFF;
+
+    MegaTxScheduler(HardwareSerial &port, uint8_t *storage, uint16_t safetyBytes, uint16_t stateBytes,
+                    uint16_t periodicBytes, uint16_t debugBytes)
+        : port(port), framer(nullptr), activeClass(NONE_ACTIVE), activeData(nullptr), activeRemaining(0),
+          mergedCount(0), delimiterPending(false) {
+        const uint16_t capacities[PRIORITY_COUNT] = {safetyBytes, stateBytes, periodicBytes, debugBytes};
+        for (uint8_t i = 0; i < PRIORITY_COUNT; i++) {
+            rings[i].buffer = storage;
+            rings[i].capacity = capacities[i];
+            rings[i].head = 0;
+            rings[i].used = 0;
+            rings[i].dropped = 0;
+            storage += capacities[i];
+        }
+    }
+
+    // Frames are framed by framer as they are picked for sending; nullptr writes them as queued.
+    void setFramer(TxFramer *frameBuilder) {
+        framer = frameBuilder;
+    }
+
+    // Returns true if a frame of the given length would currently be accepted.
+    bool canAccept(uint16_t length, TxPriority priority) const {
+        const FrameRing &ring = rings[static_cast<uint8_t>(priority)];
+        return freeSpace(ring) >= length + RECORD_HEADER_SIZE;
+    }
+
+    // Queues a frame for transmission.  Returns false if the frame was not queued.
+    bool enqueue(const uint8_t *data, uint16_t length, TxPriority priority, uint8_t mergeKey = NO_MERGE,
+                 uint16_t tag = 0) {
+        uint8_t classIndex = static_cast<uint8_t>(priority);
+        FrameRing &ring = rings[classIndex];
+        uint16_t needed = length + RECORD_HEADER_SIZE;
+        if (length == 0 || needed > ring.capacity) {
+            ring.dropped++;
+            return false;
+        }
+        if (mergeKey != NO_MERGE) {
+            supersede(classIndex, mergeKey);
+        }
+        if (priority == TxPriority::PERIODIC) {
+            // fresher periodic data is worth more than older, so make room at the front.
+            while (freeSpace(ring) < needed && evictOldest(classIndex)) {
+            }
+        }
+        if (freeSpace(ring) < needed) {
+            ring.dropped++;
+            return false;
+        }
+        uint8_t header[RECORD_HEADER_SIZE] = {static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(length >> 8),
+                                              mergeKey, static_cast<uint8_t>(tag & 0xFF),
+                                              static_cast<uint8_t>(tag >> 8)};
+        uint16_t tail = wrap(ring, ring.head + ring.used);
+        copyIn(ring, tail, header, RECORD_HEADER_SIZE);
+        copyIn(ring, wrap(ring, tail + RECORD_HEADER_SIZE), data, length);
+        ring.used += needed;
+        return true;
+    }
+
+    bool enqueue(const String &frame, TxPriority priority, uint8_t mergeKey = NO_MERGE) {
+        return enqueue(reinterpret_cast<const uint8_t *>(frame.c_str()), frame.length(), priority, mergeKey);
+    }
+
+    // Call every loop(): writes as many queued bytes as the UART can take without blocking.
+    void service() {
+        service(0xFFFF);
+    }
+
+    // Like service(), but starts no new frame once byteLimit bytes have been written; the
+    // frame in flight is always finished.  Returns the number of bytes written.
+    uint16_t service(uint16_t byteLimit) {
+        int room = port.availableForWrite();
+        uint16_t written = 0;
+        while (room > 0) {
+            if (activeClass == NONE_ACTIVE && delimiterPending) {
+                port.write(static_cast<uint8_t>(0));
+                delimiterPending = false;
+                room--;
+                written++;
+                continue;
+            }
+            if (activeClass == NONE_ACTIVE && (written >= byteLimit || !startNextFrame())) {
+                return written;
+            }
+            // write the largest contiguous run that fits in the hardware buffer.
+            uint16_t chunk = activeRemaining;
+            if (chunk > static_cast<uint16_t>(room)) {
+                chunk = room;
+            }
+            if (activeData != nullptr) {
+                port.write(activeData, chunk);
+                activeData += chunk;
+            } else {
+                FrameRing &ring = rings[activeClass];
+                if (chunk > ring.capacity - ring.head) {
+                    chunk = ring.capacity - ring.head;
+                }
+                port.write(ring.buffer + ring.head, chunk);
+                ring.head = wrap(ring, ring.head + chunk);
+                ring.used -= chunk;
+            }
+            activeRemaining -= chunk;
+            room -= chunk;
+            written += chunk;
+            if (activeRemaining == 0) {
+                activeClass = NONE_ACTIVE;
+                activeData = nullptr;
+            }
+        }
+        return written;
+    }
+
+    // Drops every queued frame in a priority class that carries mergeKey, for a caller that
+    // has just queued a frame in another class holding everything they did.  A frame in
+    // flight is still finished.
+    void supersede(TxPriority priority, uint8_t mergeKey) {
+        supersede(static_cast<uint8_t>(priority), mergeKey);
+    }
+
+    // The lowest priority class, from priority down, that still holds a queued frame which
+    // cannot be superseded and shares a tag bit with tags; priority itself if none does.
+    // Classes drain highest first, so a frame queued in that class goes out after all of them.
+    TxPriority lowestHolding(TxPriority priority, uint16_t tags) const {
+        uint8_t lowest = static_cast<uint8_t>(priority);
+        for (uint8_t classIndex = lowest + 1; classIndex < PRIORITY_COUNT; classIndex++) {
+            const FrameRing &ring = rings[classIndex];
+            uint16_t remaining;
+            uint16_t position = firstQueuedRecord(classIndex, remaining);
+            while (remaining > 0) {
+                uint16_t recordSize = recordLength(ring, position) + RECORD_HEADER_SIZE;
+                if (ring.buffer[wrap(ring, position + 2)] == NO_MERGE && (recordTag(ring, position) & tags) != 0) {
+                    lowest = classIndex;
+                    break;
+                }
+                position = wrap(ring, position + recordSize);
+                remaining -= recordSize;
+            }
+        }
+        return static_cast<TxPriority>(lowest);
+    }
+
+    // Drops the unsent rest of the frame in flight, for a caller that cannot wait for it;
+    // what was written is left for the receiver to discard once a delimiter follows.
+    void abandonFrame() {
+        if (activeClass == NONE_ACTIVE) {
+            return;
+        }
+        FrameRing &ring = rings[activeClass];
+        if (activeData == nullptr) {
+            skipRecord(ring, activeRemaining);
+        }
+        ring.dropped++;
+        activeClass = NONE_ACTIVE;
+        activeData = nullptr;
+        activeRemaining = 0;
+    }
+
+    // Writes a lone 0x00 ahead of the next frame, between frames, e.g. so a receiver that
+    // lost sync after a baud rate change drops whatever it had collected.
+    void requestDelimiter() {
+        delimiterPending = true;
+    }
+
+    // True while a frame has been partly written to the UART.
+    bool isFrameInFlight() const {
+        return activeClass != NONE_ACTIVE;
+    }
+
+    // True when nothing is queued or in flight.
+    bool isIdle() const {
+        if (activeClass != NONE_ACTIVE) {
+            return false;
+        }
+        for (uint8_t i = 0; i < PRIORITY_COUNT; i++) {
+            if (rings[i].used > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bytes queued in a priority class, including record headers and any in-flight remainder.
+    uint16_t getQueuedBytes(TxPriority priority) const {
+        uint8_t classIndex = static_cast<uint8_t>(priority);
+        return rings[classIndex].used + (classIndex == activeClass && activeData != nullptr ? activeRemaining : 0);
+    }
+
+    // Frames refused or evicted in a priority class since start-up.
+    uint16_t getDroppedFrames(TxPriority priority) const {
+        return rings[static_cast<uint8_t>(priority)].dropped;
+    }
+
+    // Frames replaced by a newer frame with the same merge key since start-up.
+    uint16_t getMergedFrames() const {
+        return mergedCount;
+    }
+
+private:
+    // Each queued frame is stored as [length low][length high][merge key][tag low][tag high]
+    // [payload...].
+    static const uint8_t RECORD_HEADER_SIZE = 5;
+    // Merge key written over a record that a newer frame has replaced.
+    static const uint8_t SUPERSEDED = 0xFE;
+    static const uint8_t NONE_ACTIVE = 0xFF;
+
+    struct FrameRing {
+        uint8_t *buffer;
+        uint16_t capacity;
+        uint16_t head; // first byte not yet transmitted
+        uint16_t used; // bytes queued, including the unsent part of an in-flight frame
+        uint16_t dropped;
+    };
+
+    HardwareSerial &port;
+    TxFramer *framer;
+    FrameRing rings[PRIORITY_COUNT];
+    uint8_t activeClass;       // class whose frame is currently being written, or NONE_ACTIVE
+    const uint8_t *activeData; // rest of the framed in-flight frame; nullptr while it is in its ring
+    uint16_t activeRemaining;  // bytes of the in-flight frame still to write
+    uint16_t mergedCount;
+    bool delimiterPending;
+
+    static uint16_t wrap(const FrameRing &ring, uint16_t position) {
+        return position >= ring.capacity ? position - ring.capacity : position;
+    }
+
+    static uint16_t freeSpace(const FrameRing &ring) {
+        return ring.capacity - ring.used;
+    }
+
+    static void copyIn(FrameRing &ring, uint16_t position, const uint8_t *data, uint16_t length) {
+        for (uint16_t i = 0; i < length; i++) {
+            ring.buffer[position] = data[i];
+            position = wrap(ring, position + 1);
+        }
+    }
+
+    static uint16_t recordLength(const FrameRing &ring, uint16_t position) {
+        return ring.buffer[position] | (ring.buffer[wrap(ring, position + 1)] << 8);
+    }
+
+    static uint16_t recordTag(const FrameRing &ring, uint16_t position) {
+        return ring.buffer[wrap(ring, position + 3)] | (ring.buffer[wrap(ring, position + 4)] << 8);
+    }
+
+    // True if the unsent part of the in-flight frame is still at the front of a class's ring.
+    bool holdsFrameInFlight(uint8_t classIndex) const {
+        return classIndex == activeClass && activeData == nullptr;
+    }
+
+    // Position of the first record that has not started transmitting.
+    uint16_t firstQueuedRecord(uint8_t classIndex, uint16_t &queuedBytes) const {
+        const FrameRing &ring = rings[classIndex];
+        uint16_t skip = holdsFrameInFlight(classIndex) ? activeRemaining : 0;
+        queuedBytes = ring.used - skip;
+        return wrap(ring, ring.head + skip);
+    }
+
+    // Marks every queued (not in-flight) record with mergeKey as superseded.
+    void supersede(uint8_t classIndex, uint8_t mergeKey) {
+        FrameRing &ring = rings[classIndex];
+        uint16_t remaining;
+        uint16_t position = firstQueuedRecord(classIndex, remaining);
+        while (remaining > 0) {
+            uint16_t keyPosition = wrap(ring, position + 2);
+            uint16_t recordSize = recordLength(ring, position) + RECORD_HEADER_SIZE;
+            if (ring.buffer[keyPosition] == mergeKey) {
+                ring.buffer[keyPosition] = SUPERSEDED;
+                mergedCount++;
+            }
+            position = wrap(ring, position + recordSize);
+            remaining -= recordSize;
+        }
+    }
+
+    // Drops the oldest queued record of a class.  Only possible when that class has no
+    // frame in flight, since space is reclaimed from the front of the ring.
+    bool evictOldest(uint8_t classIndex) {
+        FrameRing &ring = rings[classIndex];
+        if (holdsFrameInFlight(classIndex) || ring.used == 0) {
+            return false;
+        }
+        uint16_t recordSize = recordLength(ring, ring.head) + RECORD_HEADER_SIZE;
+        if (ring.buffer[wrap(ring, ring.head + 2)] != SUPERSEDED) {
+            ring.dropped++;
+        }
+        ring.head = wrap(ring, ring.head + recordSize);
+        ring.used -= recordSize;
+        return true;
+    }
+
+    static void skipRecord(FrameRing &ring, uint16_t length) {
+        ring.head = wrap(ring, ring.head + length);
+        ring.used -= length;
+    }
+
+    // Picks the highest priority queued frame and makes it the in-flight frame.
+    bool startNextFrame() {
+        for (uint8_t classIndex = 0; classIndex < PRIORITY_COUNT; classIndex++) {
+            FrameRing &ring = rings[classIndex];
+            while (ring.used > 0) {
+                uint16_t length = recordLength(ring, ring.head);
+                uint8_t mergeKey = ring.buffer[wrap(ring, ring.head + 2)];
+                uint16_t tag = recordTag(ring, ring.head);
+                ring.head = wrap(ring, ring.head + RECORD_HEADER_SIZE);
+                ring.used -= RECORD_HEADER_SIZE;
+                if (mergeKey == SUPERSEDED) {
+                    skipRecord(ring, length);
+                    continue;
+                }
+                if (framer != nullptr) {
+                    uint16_t part1 = length < ring.capacity - ring.head ? length : ring.capacity - ring.head;
+                    uint16_t wireLength = 0;
+                    const uint8_t *wire = framer->frameRecord(ring.buffer + ring.head, part1, ring.buffer,
+                                                              length - part1, mergeKey, tag, wireLength);
+                    skipRecord(ring, length);
+                    if (wire == nullptr || wireLength == 0) {
+                        ring.dropped++;
+                        continue;
+                    }
+                    activeData = wire;
+                    length = wireLength;
+                }
+                activeClass = classIndex;
+                activeRemaining = length;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Owns the ring storage for a MegaTxScheduler; sizes are in bytes per priority class.
+template <uint16_t SAFETY_BYTES, uint16_t STATE_BYTES, uint16_t PERIODIC_BYTES, uint16_t DEBUG_BYTES>
+class MegaTxChannel : public MegaTxScheduler {
+public:
+    explicit MegaTxChannel(HardwareSerial &port) :
+        MegaTxScheduler(port, storage, SAFETY_BYTES, STATE_BYTES, PERIODIC_BYTES, DEBUG_BYTES) {}
+
+private:
+    uint8_t storage[SAFETY_BYTES + STATE_BYTES + PERIODIC_BYTES + DEBUG_BYTES];
+};
+
+// Print adapter that collects text into lines and queues each line on a scheduler,
+// so existing print()/println() call sites become non-blocking.
+class MegaTxPrint : public Print {
+public:
+    MegaTxPrint(MegaTxScheduler &scheduler, TxPriority priority) :
+        scheduler(scheduler), priority(priority), lineLength(0) {}
+
+    size_t write(uint8_t c) override {
+        lineBuffer[lineLength++] = c;
+        if (c == '\n' || lineLength == LINE_SIZE) {
+            flush();
+        }
+        return 1;
+    }
+    using Print::write;
+
+    // Queues whatever has been collected so far, even without a trailing newline.
+    void flush() override {
+        if (lineLength > 0) {
+            scheduler.enqueue(lineBuffer, lineLength, priority);
+            lineLength = 0;
+        }
+    }
+
+private:
+    static const uint8_t LINE_SIZE = 80;
+    MegaTxScheduler &scheduler;
+    TxPriority priority;
+    uint8_t lineBuffer[LINE_SIZE];
+    uint8_t lineLength;
+};
+
+// Console output for debug messages, defined in mega2560_main.cpp.  Queued at DEBUG
+// priority and dropped under backpressure rather than stalling the control loop.
+extern MegaTxPrint debugSerial;
+
+} // namespace ActuatorsController
@@ -0,0 +1,100 @@
+//
+// ActuatorCommandExecutor.cpp
+// Description: Sequenced command delivery to the Mega with ACK/NAK tracking.
+//
+#include "esp32/ActuatorCommandExecutor.h"
+#include "link/LinkSchema.h"
+
+namespace ActuatorsController {
+
+ActuatorCommandExecutor::ActuatorCommandExecutor(Stream &link, uint8_t node)
+    : link(link), node(node), nextSequence(1), history(), ackedCount(0), nakedCount(0), timeoutCount(0) {}
+
+uint16_t ActuatorCommandExecutor::send(Opcode opcode, uint8_t actuator) {
+    uint16_t sequence = nextSequence;
+    CommandMessage command;
+    command.opcode = static_cast<uint8_t>(opcode);
+    command.actuator = actuator;
+    LinkFrameWriter frame(FrameType::COMMAND);
+    frame.setNode(node);
+    encodeMessage(frame, command);
+    uint8_t encoded[LINK_MAX_ENCODED_SIZE];
+    size_t length = frame.encode(sequence, encoded, sizeof(encoded));
+    if (length == 0) {
+        return 0;
+    }
+    nextSequence++;
+    // sequence 0 is reserved for unsequenced commands.
+    if (nextSequence == 0) {
+        nextSequence = 1;
+    }
+    SentCommand &entry = history[sequence % HISTORY_SIZE];
+    entry.sequence = sequence;
+    entry.sentAt = millis();
+    entry.state = CommandState::PENDING;
+    entry.status = CommandStatus::OK;
+
+    link.write(encoded, length);
+    return sequence;
+}
+
+void ActuatorCommandExecutor::handleAcknowledgement(uint16_t sequence, CommandStatus status) {
+    SentCommand *entry = find(sequence);
+    if (entry == nullptr || entry->state != CommandState::PENDING) {
+        // unsequenced commands, or ones we already gave up on.
+        return;
+    }
+    entry->status = status;
+    if (status == CommandStatus::OK) {
+        entry->state = CommandState::ACKED;
+        ackedCount++;
+    } else {
+        entry->state = CommandState::NAKED;
+        nakedCount++;
+    }
+}
+
+void ActuatorCommandExecutor::expirePending() {
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < HISTORY_SIZE; i++) {
+        if (history[i].state == CommandState::PENDING && now - history[i].sentAt >= ACK_TIMEOUT) {
+            history[i].state = CommandState::TIMED_OUT;
+            timeoutCount++;
+        }
+    }
+}
+
+ActuatorCommandExecutor::CommandState ActuatorCommandExecutor::getState(uint16_t sequence) const {
+    const SentCommand *entry = find(sequence);
+    return entry ? entry->state : CommandState::UNKNOWN;
+}
+
+const char *ActuatorCommandExecutor::getStatus(uint16_t sequence) const {
+    const SentCommand *entry = find(sequence);
+    if (entry == nullptr || (entry->state != CommandState::ACKED && entry->state != CommandState::NAKED)) {
+        return "";
+    }
+    return commandStatusName(entry->status);
+}
+
+const char *ActuatorCommandExecutor::stateName(CommandState state) {
+    switch (state) {
+        case CommandState::PENDING: return "pending";
+        case CommandState::ACKED: return "acked";
+        case CommandState::NAKED: return "naked";
+        case CommandState::TIMED_OUT: return "timed out";
+        default: return "unknown";
+    }
+}
+
+ActuatorCommandExecutor::SentCommand *ActuatorCommandExecutor::find(uint16_t sequence) {
+    SentCommand &entry = history[sequence % HISTORY_SIZE];
+    return (sequence != 0 && entry.sequence == sequence) ? &entry : nullptr;
+}
+
+const ActuatorCommandExecutor::SentCommand *ActuatorCommandExecutor::find(uint16_t sequence) const {
+    const SentCommand &entry = history[sequence % HISTORY_SIZE];
+    return (sequence != 0 && entry.sequence == sequence) ? &entry : nullptr;
+}
+
+} // namespace ActuatorsController
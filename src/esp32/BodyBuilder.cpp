@@ -53,19 +53,31 @@ using namespace ActuatorsController;
 
  // buildBody() overload for processing StatusReportData.
 String BodyBuilder::buildBody(const StatusReportData &statusReport) {
-  	String html = "";
+    String html;
+    StringPageSink out(html);
+    writeBody(out, statusReport);
+    out.flush();
+    return html;
+}
+
+// Writes the body straight into the sink, so no part of the page is held as a String.
+void BodyBuilder::writeBody(PageSink &out, const StatusReportData &statusReport) {
     // Open body tag.
-    html += "\n<body>\n";
+    out.write("\n<body>\n");
+    // Link state from the StatusReportProcessor, e.g. when the Mega has gone silent.
+    if (statusReport.statusMessage != nullptr && statusReport.statusMessage[0] != '\0') {
+        out.write("<div class='status'>Status: ");
+        out.write(statusReport.statusMessage);
+        out.write("</div>\n");
+    }
 
     // Append any pre-existing content (for example, control buttons).
-    html += bodyContent;
+    out.write(bodyContent);
     // Optionally, append additional control buttons if needed.
-    html += buildControlButtons(statusReport);
+    writeControlButtons(out, statusReport);
 
     // Close body tag.
-    html += "\n</body>\n";
-
-    return html;
+    out.write("\n</body>\n");
 }
 
 
@@ -77,87 +89,93 @@ String BodyBuilder::buildBody(const StatusReportData &statusReport) {
 //   - For the "retract" button, do the opposite.
 //   - In all other cases, return a neutral styling.
 // (You can later define the actual CSS for these classes.)
-static String getFrameClass(const String &buttonAction, const String &currentMode) {
-    if (buttonAction == "extend") {
-        if (currentMode == "extending")
-            return "highlight-light";
-        else if (currentMode == "retracting")
-            return "highlight-dark";
-    } else if (buttonAction == "retract") {
-        if (currentMode == "retracting")
-            return "highlight-light";
-        else if (currentMode == "extending")
-            return "highlight-dark";
-    }
+static const char *getFrameClass(bool extend, LinkMode currentMode) {
+    LinkMode sameWay = extend ? LinkMode::EXTENDING : LinkMode::RETRACTING;
+    LinkMode otherWay = extend ? LinkMode::RETRACTING : LinkMode::EXTENDING;
+    if (currentMode == sameWay)
+        return "highlight-light";
+    else if (currentMode == otherWay)
+        return "highlight-dark";
     return "highlight-neutral";
 }
 
 // -----------------------------------------------------------------------------
-// Helper: Constructs the HTML for one control button.
+// Helper: Writes the HTML for one control button.
 // The actual button is always rendered in its neutral base style (green for extend,
 // red for retract). An outer wrapping div is given the highlight class as determined
 // from the live mode.
-static String buildButton(const String &actuatorName, const String &action, const String &currentMode) {
-    String btnHtml;
-    String frameClass = getFrameClass(action, currentMode);
-    btnHtml += "<div class='button-frame " + frameClass + "'>";
-    btnHtml += "<button id='" + actuatorName + "_" + action + "' class='control-btn " +
-               (action == "extend" ? "green" : "red") + "' ";
-    btnHtml += "onclick=\"handleWindowAction('" + actuatorName + "', '" + action + "')\">";
-    btnHtml += (action == "extend" ? "Extend" : "Retract");
-    btnHtml += "</button>";
-    btnHtml += "</div>\n";
-    return btnHtml;
+static void writeButton(PageSink &out, const char *actuatorName, bool extend, LinkMode currentMode) {
+    const char *action = extend ? "extend" : "retract";
+    out.write("<div class='button-frame ");
+    out.write(getFrameClass(extend, currentMode));
+    out.write("'>");
+    out.write("<button id='");
+    out.write(actuatorName);
+    out.write("_");
+    out.write(action);
+    out.write(extend ? "' class='control-btn green' " : "' class='control-btn red' ");
+    out.write("onclick=\"handleWindowAction('");
+    out.write(actuatorName);
+    out.write("', '");
+    out.write(action);
+    out.write("')\">");
+    out.write(extend ? "Extend" : "Retract");
+    out.write("</button>");
+    out.write("</div>\n");
 }
 
-
 // -----------------------------------------------------------------------------
-// Helper: Builds the control group for an individual actuator using its live data.
+// Helper: Writes the control group for an individual actuator using its live data.
 // The actuator name is generated as "Actuator <index>".
-static String formatActuatorControl(const ActuatorData &actuator) {
-    String html;
-    String actuatorName = "Actuator " + String(actuator.index);
-    html += "<div class='control-group'>\n";
-    html += "<h3>" + actuatorName + "</h3>\n";
+static void writeActuatorControl(PageSink &out, const ActuatorData &actuator) {
+    char actuatorName[16];
+    snprintf(actuatorName, sizeof(actuatorName), "Actuator %u", actuator.index);
+    out.write("<div class='control-group'>\n");
+    out.write("<h3>");
+    out.write(actuatorName);
+    out.write("</h3>\n");
+    // Travel so far, estimated between reports by PositionEstimator, once it is known.
+    if (actuator.generation != 0 && actuator.maxDuration != 0) {
+        out.write("<progress class='position' max='");
+        out.write(actuator.maxDuration);
+        out.write("' value='");
+        out.write(actuator.position);
+        out.write("'></progress>\n");
+    }
     // Create the Extend and Retract buttons, using the current actuator mode
     // to decide on the highlighting.
-    html += buildButton(actuatorName, "extend", actuator.mode);
-    html += buildButton(actuatorName, "retract", actuator.mode);
-    html += "</div>\n";
-    return html;
+    writeButton(out, actuatorName, true, actuator.mode);
+    writeButton(out, actuatorName, false, actuator.mode);
+    out.write("</div>\n");
 }
 
 // -----------------------------------------------------------------------------
-// Helper: Builds the controls for "All Actuators".
+// Helper: Writes the controls for "All Actuators".
 // Here you might aggregate live data for all actuators; for now, we assume a
 // neutral mode so the buttons are not highlighted.
-static String formatAllActuatorsControl(const StatusReportData &report) {
-    String html;
-    String actuatorName = "All Actuators";
+static void writeAllActuatorsControl(PageSink &out, const StatusReportData &report) {
+    const char *actuatorName = "All Actuators";
     // In a real implementation you might compute an overall mode from report data.
-    String overallMode = "neutral";
-    html += "<div class='control-group'>\n";
-    html += "<h3>" + actuatorName + "</h3>\n";
-    html += buildButton(actuatorName, "extend", overallMode);
-    html += buildButton(actuatorName, "retract", overallMode);
-    html += "</div>\n";
-    return html;
+    LinkMode overallMode = LinkMode::IDLE;
+    out.write("<div class='control-group'>\n");
+    out.write("<h3>");
+    out.write(actuatorName);
+    out.write("</h3>\n");
+    writeButton(out, actuatorName, true, overallMode);
+    writeButton(out, actuatorName, false, overallMode);
+    out.write("</div>\n");
 }
 
 // -----------------------------------------------------------------------------
-// Revised buildControlButtons using StatusReportData.
-// (Note: The function’s signature has been modified to accept live status data.)
-// This function iterates over the live actuator data and produces a control group
-// for each actuator, plus a separate control group for "All Actuators".
-String BodyBuilder::buildControlButtons(const StatusReportData &statusReport) {
-    String buttons;
+// Writes a control group for each actuator from the live status data, plus a
+// separate control group for "All Actuators".
+void BodyBuilder::writeControlButtons(PageSink &out, const StatusReportData &statusReport) {
     // Iterate through each actuator in the live status report.
     for (uint8_t i = 0; i < TOTAL_ACTUATORS; ++i) {
-        buttons += formatActuatorControl(statusReport.actuators[i]);
+        writeActuatorControl(out, statusReport.actuators[i]);
     }
     // Add the control group for "All Actuators"
-    buttons += formatAllActuatorsControl(statusReport);
-    return buttons;
+    writeAllActuatorsControl(out, statusReport);
 }
 
 /** duplicate entry it looks like
@@ -167,7 +185,7 @@ String BodyBuilder::buildControlButtons(const StatusReportData &statusReport) {
 String BodyBuilder::buildBody(const StatusReportData &statusReport) {
     String html = "<!DOCTYPE html>\n<html>\n";
     html += "\n<body>\n";
-    html += "<div class='status'>Status: " + statusReport.statusMessage + "</div>\n";
+    html += "<div class='status'>Status: " + String(statusReport.statusMessage) + "</div>\n";
     html += bodyContent;
     // Use the live data version of buildControlButtons.
     html += buildControlButtons(statusReport);
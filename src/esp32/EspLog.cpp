@@ -0,0 +1,155 @@
+//
+// EspLog.cpp
+// Description: Record ring and console output of the ESP32 log.
+//
+#include "esp32/EspLog.h"
+#include <stdio.h>
+
+namespace ActuatorsController {
+
+EspLog espLog;
+
+static const char *const MODULE_NAMES[] = {"LINK", "STATUS", "COMMAND", "RATE", "BUS"};
+static const char LEVEL_LETTERS[] = {'-', 'E', 'W', 'I', 'D'};
+
+EspLog::EspLog() : writePosition(0), readPosition(0), droppedCount(0), reportedDrops(0), lineLength(0), lineSent(0) {
+    for (uint16_t i = 0; i < CAPACITY; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// A writer claims a position by moving writePosition past it, fills the slot and only then
+// publishes it through the slot's sequence, so drain() never sees half a record.
+void EspLog::push(LogModule module, LogLevel level, const char *format, const LogArgument *arguments,
+                  uint8_t count) {
+    uint32_t position = writePosition.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &slots[position & (CAPACITY - 1)];
+        int32_t lag = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - position);
+        if (lag == 0) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // the slot still holds a record drain() has not taken: the ring is full.
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+    LogRecord &record = slot->record;
+    record.format = format;
+    record.millis = millis();
+    record.module = module;
+    record.level = level;
+    record.argumentCount = count;
+    for (uint8_t i = 0; i < count; i++) {
+        record.arguments[i] = arguments[i];
+    }
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+bool EspLog::pop(LogRecord &record) {
+    Slot &slot = slots[readPosition & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+        return false;
+    }
+    record = slot.record;
+    slot.sequence.store(readPosition + CAPACITY, std::memory_order_release);
+    readPosition++;
+    return true;
+}
+
+void EspLog::drain(HardwareSerial &port) {
+    for (;;) {
+        if (lineSent == lineLength) {
+            uint32_t dropped = getDroppedCount();
+            LogRecord record;
+            if (dropped != reportedDrops) {
+                lineLength = snprintf(line, sizeof(line), "[log] %lu record(s) dropped\r\n",
+                                      static_cast<unsigned long>(dropped - reportedDrops));
+                reportedDrops = dropped;
+            } else if (pop(record)) {
+                formatLine(record);
+            } else {
+                return;
+            }
+            lineSent = 0;
+        }
+        int room = port.availableForWrite();
+        if (room <= 0) {
+            return;
+        }
+        size_t chunk = lineLength - lineSent;
+        if (chunk > static_cast<size_t>(room)) {
+            chunk = room;
+        }
+        port.write(reinterpret_cast<const uint8_t *>(line) + lineSent, chunk);
+        lineSent += chunk;
+    }
+}
+
+// "<millis> <MODULE> <level letter> <message>", cut to LINE_SIZE.
+void EspLog::formatLine(const LogRecord &record) {
+    const size_t limit = sizeof(line) - 2; // room for the line ending
+    size_t length = snprintf(line, limit, "%lu %s %c ", static_cast<unsigned long>(record.millis),
+                             MODULE_NAMES[static_cast<uint8_t>(record.module)],
+                             LEVEL_LETTERS[static_cast<uint8_t>(record.level)]);
+    uint8_t next = 0;
+    for (const char *c = record.format; *c != '\0' && length < limit - 1; c++) {
+        if (*c != '%') {
+            line[length++] = *c;
+            continue;
+        }
+        c++;
+        // length modifiers mean nothing here; every argument is stored as 32 bits.
+        while (*c == 'l' || *c == 'h') {
+            c++;
+        }
+        if (*c == '\0') {
+            break;
+        }
+        if (*c == '%') {
+            line[length++] = '%';
+            continue;
+        }
+        if (next == record.argumentCount) {
+            // more conversions than arguments: leave the conversion as it is.
+            line[length++] = '%';
+            line[length++] = *c;
+            continue;
+        }
+        const LogArgument &argument = record.arguments[next++];
+        size_t room = limit - length;
+        int written;
+        switch (*c) {
+            case 'd':
+            case 'i':
+                written = snprintf(line + length, room, "%ld", static_cast<long>(argument.i));
+                break;
+            case 'x':
+                written = snprintf(line + length, room, "%lx", static_cast<unsigned long>(argument.u));
+                break;
+            case 'X':
+                written = snprintf(line + length, room, "%lX", static_cast<unsigned long>(argument.u));
+                break;
+            case 'c':
+                written = snprintf(line + length, room, "%c", static_cast<char>(argument.u));
+                break;
+            case 's':
+                written = snprintf(line + length, room, "%s", argument.s != nullptr ? argument.s : "(null)");
+                break;
+            default:
+                written = snprintf(line + length, room, "%lu", static_cast<unsigned long>(argument.u));
+                break;
+        }
+        length += written < static_cast<int>(room) ? written : room - 1;
+    }
+    line[length++] = '\r';
+    line[length++] = '\n';
+    lineLength = length;
+}
+
+} // namespace ActuatorsController
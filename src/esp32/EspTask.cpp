@@ -0,0 +1,55 @@
+//
+// EspTask.cpp
+// Description: Task loop and load measurement of the ESP32's pinned tasks.
+//
+#include "esp32/EspTask.h"
+
+namespace ActuatorsController {
+
+EspTask::EspTask(const char *name, uint32_t stackBytes, UBaseType_t priority, BaseType_t core, TickType_t period) :
+    name(name), stackBytes(stackBytes), priority(priority), core(core), period(period), step(nullptr),
+    context(nullptr), handle(nullptr), loadPermille(0), maxStepMicros(0) {}
+
+bool EspTask::start(Step taskStep, void *taskContext) {
+    step = taskStep;
+    context = taskContext;
+    return xTaskCreatePinnedToCore(run, name, stackBytes, this, priority, &handle, core) == pdPASS;
+}
+
+void EspTask::notify() {
+    if (handle != nullptr) {
+        xTaskNotifyGive(handle);
+    }
+}
+
+uint32_t EspTask::getStackHighWater() const {
+    // the ESP32 port counts stack in bytes.
+    return handle != nullptr ? uxTaskGetStackHighWaterMark(handle) : 0;
+}
+
+void EspTask::run(void *parameter) {
+    EspTask &task = *static_cast<EspTask *>(parameter);
+    uint32_t windowStart = micros();
+    uint32_t busy = 0;
+    for (;;) {
+        uint32_t start = micros();
+        task.step(task.context);
+        uint32_t now = micros();
+        uint32_t elapsed = now - start;
+        busy += elapsed;
+        if (elapsed > task.maxStepMicros.load(std::memory_order_relaxed)) {
+            task.maxStepMicros.store(elapsed, std::memory_order_relaxed);
+        }
+        if (now - windowStart >= LOAD_WINDOW_US) {
+            task.loadPermille.store(static_cast<uint16_t>(static_cast<uint64_t>(busy) * 1000 / (now - windowStart)),
+                                    std::memory_order_relaxed);
+            windowStart = now;
+            busy = 0;
+        }
+        // notifications that came in during the step are taken together, so a burst of them
+        // costs one extra step, not one each.
+        ulTaskNotifyTake(pdTRUE, task.period > 0 ? task.period : 1);
+    }
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,186 @@
+//
+// LinkBus.cpp
+// Description: Round-robin polling of the Megas on the RS-485 bus.
+//
+#include "esp32/LinkBus.h"
+
+namespace ActuatorsController {
+
+size_t LinkOutbox::write(const uint8_t *data, size_t size) {
+    if (size > static_cast<size_t>(CAPACITY - length)) {
+        droppedCount++;
+        return 0;
+    }
+    memcpy(buffer + length, data, size);
+    length += size;
+    return size;
+}
+
+uint16_t LinkOutbox::drainTo(Print &port, uint16_t limit) {
+    uint16_t count = length;
+    if (count > limit) {
+        // stop after the last delimiter that fits.
+        count = limit;
+        while (count > 0 && buffer[count - 1] != 0) {
+            count--;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    port.write(buffer, count);
+    length -= count;
+    memmove(buffer, buffer + count, length);
+    return count;
+}
+
+LinkBus::LinkBus(HardwareSerial &port, int dePin) : port(port), dePin(dePin) {}
+
+bool LinkBus::addNode(LinkNode &node) {
+    if (nodeCount == LINK_MAX_NODES) {
+        return false;
+    }
+    nodes[nodeCount++] = &node;
+    return true;
+}
+
+void LinkBus::begin() {
+    pinMode(dePin, OUTPUT);
+    digitalWrite(dePin, LOW);
+    txIdle = port.availableForWrite();
+    roundStart = millis();
+}
+
+bool LinkBus::update() {
+    if (nodeCount == 0) {
+        return false;
+    }
+    bool updated = receive();
+    for (uint8_t i = 0; i < nodeCount; i++) {
+        LinkNode &node = *nodes[i];
+        node.executor.expirePending();
+        // queued in the outbox and sent with the node's next poll.
+        node.processor.serviceHeartbeat();
+        updated |= node.processor.checkLinkState();
+    }
+    if (sending && !releaseDriver()) {
+        return updated;
+    }
+    if (waiting) {
+        unsigned long now = millis();
+        if (now - lastHeard < POLL_TIMEOUT_MS && now - pollStart < TURN_TIMEOUT_MS) {
+            return updated;
+        }
+        nodes[current]->timeoutCount++;
+        nextNode();
+    }
+    if (turningAround && micros() - turnaroundStart < TURNAROUND_MICROS) {
+        return updated;
+    }
+    turningAround = false;
+    poll(*nodes[current]);
+    return updated;
+}
+
+LinkNode *LinkBus::findNode(uint8_t address) {
+    for (uint8_t i = 0; i < nodeCount; i++) {
+        if (nodes[i]->address == address) {
+            return nodes[i];
+        }
+    }
+    return nullptr;
+}
+
+const StatusReportData *LinkBus::getReport(uint8_t address) {
+    LinkNode *node = findNode(address);
+    return node != nullptr ? &node->processor.getReport() : nullptr;
+}
+
+bool LinkBus::receive() {
+    bool updated = false;
+    uint8_t chunk[READ_CHUNK];
+    int waiting;
+    while ((waiting = port.available()) > 0) {
+        size_t count = port.readBytes(chunk, waiting < static_cast<int>(READ_CHUNK) ? waiting : READ_CHUNK);
+        if (count == 0) {
+            break;
+        }
+        size_t used = 0;
+        while (used < count) {
+            bool complete;
+            used += decoder.feed(chunk + used, count - used, complete);
+            if (complete) {
+                updated |= dispatch(decoder.getFrame());
+            }
+        }
+    }
+    return updated;
+}
+
+// Frames are handed to the node they come from whether or not it holds the turn, so a
+// node that overran its turn still gets its late frames counted.
+bool LinkBus::dispatch(const LinkFrame &frame) {
+    LinkNode *node = findNode(frame.node);
+    if (node == nullptr) {
+        strayFrameCount++;
+        return false;
+    }
+    bool updated = node->processor.handleFrame(frame);
+    if (waiting && node == nodes[current]) {
+        lastHeard = millis();
+        if (frame.type == FrameType::END) {
+            nextNode();
+        }
+    }
+    return updated;
+}
+
+// Starts a poll; releaseDriver() ends it once its bytes are out.  The poll opens with a lone
+// delimiter, so what is left of a frame a node broke off when its turn ran out is dropped
+// before anything else is decoded, here and on every node.
+void LinkBus::poll(LinkNode &node) {
+    LinkFrameWriter frame(FrameType::POLL);
+    frame.setNode(node.address);
+    uint8_t encoded[LINK_MAX_ENCODED_SIZE];
+    size_t length = frame.encode(0, encoded, sizeof(encoded));
+    decoder.feed(static_cast<uint8_t>(0));
+    digitalWrite(dePin, HIGH);
+    port.write(static_cast<uint8_t>(0));
+    node.outbox.drainTo(port, OUTBOX_BYTES_PER_POLL);
+    port.write(encoded, length);
+    node.pollCount++;
+    sending = true;
+}
+
+// The driver is only released once the POLL frame's last byte is on the wire, since the
+// node may start answering right after it.  Until the poll is down to its last few bytes
+// this returns at once; those are waited out, under 1.5 ms at the bus rate.
+// Returns true once the driver is off and the node's turn has started.
+bool LinkBus::releaseDriver() {
+    if (txIdle - port.availableForWrite() > RELEASE_TAIL_BYTES) {
+        return false;
+    }
+    port.flush();
+    digitalWrite(dePin, LOW);
+    sending = false;
+    waiting = true;
+    pollStart = millis();
+    lastHeard = pollStart;
+    return true;
+}
+
+void LinkBus::nextNode() {
+    waiting = false;
+    turningAround = true;
+    turnaroundStart = micros();
+    current++;
+    if (current == nodeCount) {
+        current = 0;
+        roundCount++;
+        unsigned long now = millis();
+        lastRoundMillis = now - roundStart;
+        roundStart = now;
+    }
+}
+
+} // namespace ActuatorsController
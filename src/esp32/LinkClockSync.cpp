@@ -0,0 +1,112 @@
+//
+// LinkClockSync.cpp
+// Description: Offset and drift estimation from the link heartbeats.
+//
+#include "esp32/LinkClockSync.h"
+#include <sys/time.h>
+
+namespace ActuatorsController {
+
+// SNTP has set the clock once it reads later than this (September 2020).
+static const time_t WALL_CLOCK_VALID_AFTER = 1600000000;
+
+LinkClockSync::LinkClockSync() : sampleCount(0) {
+    reset();
+}
+
+void LinkClockSync::reset() {
+    synced = false;
+    offset = 0;
+    offsetLocal = 0;
+    offsetRtt = 0;
+    referenceOffset = 0;
+    referenceLocal = 0;
+    driftPpm = 0;
+    driftKnown = false;
+    windowCount = 0;
+    windowRtt = 0xFFFF;
+    windowOffset = 0;
+    windowLocal = 0;
+}
+
+// All times are millis() of one board or the other and wrap, so the sums are done modulo
+// 2^32; only differences of nearby times are read as signed.
+void LinkClockSync::addSample(const HeartbeatMessage &message, uint32_t now, uint16_t localBootId) {
+    if (message.echoBootId != localBootId) {
+        return;
+    }
+    uint32_t roundTrip = now - message.echoTimestamp;
+    if (roundTrip < message.echoDelay) {
+        return;
+    }
+    uint32_t rtt = roundTrip - message.echoDelay;
+    if (rtt > MAX_RTT_MS) {
+        return;
+    }
+    sampleCount++;
+    uint32_t received = message.timestamp - message.echoDelay;
+    uint32_t outbound = received - message.echoTimestamp;   // t2 - t1: offset plus the way out
+    uint32_t inbound = message.timestamp - now;             // t3 - t4: offset minus the way back
+    uint32_t sampleOffset = outbound + static_cast<uint32_t>(static_cast<int32_t>(inbound - outbound) / 2);
+    if (rtt < windowRtt) {
+        windowRtt = static_cast<uint16_t>(rtt);
+        windowOffset = sampleOffset;
+        windowLocal = now;
+    }
+    // the first sample syncs at once, so timestamps are usable right after the link is up.
+    if (!synced || ++windowCount >= WINDOW_SAMPLES) {
+        keep(windowOffset, windowLocal, windowRtt);
+        windowCount = 0;
+        windowRtt = 0xFFFF;
+    }
+}
+
+void LinkClockSync::keep(uint32_t sampleOffset, uint32_t sampleLocal, uint16_t rtt) {
+    if (!synced) {
+        referenceOffset = sampleOffset;
+        referenceLocal = sampleLocal;
+        synced = true;
+    } else {
+        uint32_t baseline = sampleLocal - referenceLocal;
+        if (baseline >= DRIFT_BASELINE_MS) {
+            int32_t gained = static_cast<int32_t>(sampleOffset - referenceOffset);
+            int32_t measured = static_cast<int32_t>(static_cast<int64_t>(gained) * 1000000 / baseline);
+            // smoothed, since each offset is only good to half its round trip.
+            driftPpm = driftKnown ? (3 * driftPpm + measured) / 4 : measured;
+            driftKnown = true;
+            referenceOffset = sampleOffset;
+            referenceLocal = sampleLocal;
+        }
+    }
+    offset = sampleOffset;
+    offsetLocal = sampleLocal;
+    offsetRtt = rtt;
+}
+
+uint32_t LinkClockSync::toLocal(uint32_t megaMillis) const {
+    uint32_t local = megaMillis - offset;
+    // the offset has moved on by the drift since it was measured.
+    int32_t since = static_cast<int32_t>(local - offsetLocal);
+    int32_t correction = static_cast<int32_t>(static_cast<int64_t>(since) * driftPpm / 1000000);
+    return local - static_cast<uint32_t>(correction);
+}
+
+uint64_t LinkClockSync::toWallClock(uint32_t megaMillis) const {
+    uint64_t wallNow = wallClockNow();
+    if (!synced || wallNow == 0) {
+        return 0;
+    }
+    int32_t age = static_cast<int32_t>(static_cast<uint32_t>(millis()) - toLocal(megaMillis));
+    return static_cast<uint64_t>(static_cast<int64_t>(wallNow) - age);
+}
+
+uint64_t LinkClockSync::wallClockNow() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    if (now.tv_sec < WALL_CLOCK_VALID_AFTER) {
+        return 0;
+    }
+    return static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,154 @@
+//
+// LinkRateNegotiator.cpp
+// Description: Baud rate probing, fallback and counters for the Mega link.
+//
+#include "esp32/LinkRateNegotiator.h"
+#include "esp32/EspLog.h"
+
+namespace ActuatorsController {
+
+LinkRateNegotiator::LinkRateNegotiator(HardwareSerial &port) : port(port) {}
+
+void LinkRateNegotiator::update(const LinkHeartbeat &heartbeat, const LinkFrameDecoder &decoder) {
+    unsigned long now = millis();
+    uint16_t errors = errorCount(decoder);
+    if (trying) {
+        // the switch itself may cost a frame or two; that is no reason to fall back later.
+        errorWindowStart = now;
+        errorsAtWindowStart = errors;
+        if (!probesSent) {
+            if (now - tryStart >= SWITCH_DELAY_MS) {
+                // errors from bytes caught in the switch are not the new rate's fault.
+                errorsAtProbe = errors;
+                sendProbes();
+            }
+        } else if (echoCount == PROBE_COUNT && errors == errorsAtProbe) {
+            endTry(true);
+        } else if (now - tryStart >= TRY_TIMEOUT_MS) {
+            endTry(false);
+        }
+        return;
+    }
+    if (!heartbeat.isUp(now)) {
+        upSince = now;
+    }
+    if (rateIndex != 0 && !heartbeat.heardWithin(now, FALLBACK_MS)) {
+        silenceFallbackCount++;
+        keptIndex = 0;
+        switchTo(0);
+    }
+    if (now - errorWindowStart >= ERROR_WINDOW_MS) {
+        if (rateIndex != 0 && static_cast<uint16_t>(errors - errorsAtWindowStart) > ERROR_LIMIT) {
+            // the rate tested clean but is not holding up; stay below it for a while.
+            errorFallbackCount++;
+            lowerCeiling(rateIndex - 1);
+            keptIndex = 0;
+            switchTo(0);
+        }
+        errorWindowStart = now;
+        errorsAtWindowStart = errors;
+    }
+    if (ceilingIndex < LINK_BAUD_RATE_COUNT - 1 && now - ceilingLowered >= RETRY_MS) {
+        ceilingIndex = LINK_BAUD_RATE_COUNT - 1;
+    }
+    if (rateIndex < ceilingIndex && now - upSince >= SETTLE_MS) {
+        startTry(rateIndex + 1);
+    }
+}
+
+void LinkRateNegotiator::handleProbe(const LinkFrame &frame) {
+    LinkPayloadReader payload(frame.payload, frame.payloadLength);
+    ProbeMessage probe;
+    if (!trying || !decodeMessage(payload, probe)) {
+        return;
+    }
+    if (probe.pattern0 == PROBE_PATTERN[0] && probe.pattern1 == PROBE_PATTERN[1] &&
+        probe.pattern2 == PROBE_PATTERN[2] && probe.pattern3 == PROBE_PATTERN[3]) {
+        echoCount++;
+    }
+}
+
+void LinkRateNegotiator::startTry(uint8_t index) {
+    tryCount++;
+    trying = true;
+    probesSent = false;
+    echoCount = 0;
+    tryStart = millis();
+    sendBaud(index, BaudAction::TRY);
+    switchTo(index);
+}
+
+void LinkRateNegotiator::endTry(bool clean) {
+    trying = false;
+    if (clean) {
+        keptIndex = rateIndex;
+        sendBaud(rateIndex, BaudAction::KEEP);
+    } else {
+        failedTryCount++;
+        lowerCeiling(keptIndex);
+        switchTo(keptIndex);
+    }
+    // the next try waits for the link to settle again.
+    upSince = millis();
+    ESPLOG(RATE, INFO, clean ? "Link rate kept at %u" : "Link rate failed, back to %u", getBaudRate());
+}
+
+void LinkRateNegotiator::sendBaud(uint8_t index, BaudAction action) {
+    BaudMessage baud;
+    baud.rateIndex = index;
+    baud.action = static_cast<uint8_t>(action);
+    LinkFrameWriter frame(FrameType::BAUD);
+    encodeMessage(frame, baud);
+    writeFrame(frame);
+}
+
+void LinkRateNegotiator::sendProbes() {
+    for (uint8_t number = 0; number < PROBE_COUNT; number++) {
+        ProbeMessage probe;
+        probe.number = number;
+        probe.pattern0 = PROBE_PATTERN[0];
+        probe.pattern1 = PROBE_PATTERN[1];
+        probe.pattern2 = PROBE_PATTERN[2];
+        probe.pattern3 = PROBE_PATTERN[3];
+        LinkFrameWriter frame(FrameType::PROBE);
+        encodeMessage(frame, probe);
+        writeFrame(frame);
+    }
+    probesSent = true;
+}
+
+// Sends what is still buffered at the old rate first, then a lone delimiter at the new one
+// so the Mega's decoder drops anything it half received during the change.
+void LinkRateNegotiator::switchTo(uint8_t index) {
+    if (index == rateIndex) {
+        return;
+    }
+    port.flush();
+    port.updateBaudRate(LINK_BAUD_RATES[index]);
+    port.write(static_cast<uint8_t>(0));
+    rateIndex = index;
+}
+
+void LinkRateNegotiator::lowerCeiling(uint8_t index) {
+    ceilingIndex = index;
+    ceilingLowered = millis();
+}
+
+// Frames to the Mega that are not commands carry sequence number 0.  Rates are only
+// negotiated on a direct link, where the one Mega takes broadcast frames.
+bool LinkRateNegotiator::writeFrame(LinkFrameWriter &frame) {
+    frame.setNode(LINK_NODE_BROADCAST);
+    uint8_t encoded[LINK_MAX_ENCODED_SIZE];
+    size_t length = frame.encode(0, encoded, sizeof(encoded));
+    if (length == 0) {
+        return false;
+    }
+    port.write(encoded, length);
+    return true;
+}
+
+uint16_t LinkRateNegotiator::errorCount(const LinkFrameDecoder &decoder) {
+    return static_cast<uint16_t>(decoder.getCrcErrorCount() + decoder.getFormatErrorCount());
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,85 @@
+//
+// PageSink.cpp
+// Description: Chunked page output for the web server.
+//
+#include "esp32/PageSink.h"
+#include <string.h>
+
+namespace ActuatorsController {
+
+PageSink::PageSink() : used(0), bytesWritten(0) {}
+
+void PageSink::write(const char *text) {
+    write(text, strlen(text));
+}
+
+void PageSink::write(const char *text, size_t length) {
+    bytesWritten += length;
+    while (length > 0) {
+        size_t room = CHUNK_SIZE - used;
+        size_t part = length < room ? length : room;
+        memcpy(buffer + used, text, part);
+        used += part;
+        text += part;
+        length -= part;
+        if (used == CHUNK_SIZE) {
+            flush();
+        }
+    }
+}
+
+void PageSink::write(uint32_t value) {
+    char digits[11];
+    char *start = digits + sizeof(digits);
+    do {
+        *--start = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    write(start, digits + sizeof(digits) - start);
+}
+
+void PageSink::flush() {
+    if (used == 0) {
+        return;
+    }
+    emit(buffer, used);
+    used = 0;
+}
+
+void StringPageSink::emit(const char *data, size_t length) {
+    target.concat(data, length);
+}
+
+ChunkedResponseSink::ChunkedResponseSink(WebServer &server, const char *contentType)
+    : server(server), contentType(contentType), startedAt(micros()), firstByteTime(0), totalTime(0),
+      chunkCount(0), started(false) {}
+
+// The status line and headers go out with the first chunk; with no length given the server
+// switches to chunked transfer encoding for HTTP/1.1 clients.
+void ChunkedResponseSink::start() {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, contentType, "");
+    started = true;
+}
+
+void ChunkedResponseSink::emit(const char *data, size_t length) {
+    if (!started) {
+        start();
+    }
+    server.sendContent(data, length);
+    if (chunkCount++ == 0) {
+        firstByteTime = micros() - startedAt;
+    }
+}
+
+void ChunkedResponseSink::finish() {
+    flush();
+    if (!started) {
+        start();
+    }
+    // the empty chunk ends the response.
+    server.sendContent("");
+    totalTime = micros() - startedAt;
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,44 @@
+//
+// PositionEstimator.cpp
+// Description: Dead reckoning of actuator travel from the last report.
+//
+#include "esp32/PositionEstimator.h"
+
+namespace ActuatorsController {
+
+static bool isMoving(const ActuatorData &actuator) {
+    return actuator.generation != 0 && actuator.active && actuator.mode != LinkMode::IDLE;
+}
+
+// Travel limit of an actuator; positions go over the link as 16 bits, so that is the limit
+// of one whose maxDuration has not been reported.
+static uint32_t limitOf(const ActuatorData &actuator) {
+    return actuator.maxDuration != 0 ? actuator.maxDuration : UINT16_MAX;
+}
+
+uint32_t PositionEstimator::estimate(const ActuatorData &actuator, uint32_t now) {
+    uint32_t limit = limitOf(actuator);
+    uint32_t position = actuator.position < limit ? actuator.position : limit;
+    if (!isMoving(actuator)) {
+        return position;
+    }
+    uint32_t elapsed = now - actuator.receivedAt;
+    if (actuator.mode == LinkMode::EXTENDING) {
+        return elapsed < limit - position ? position + elapsed : limit;
+    }
+    return elapsed < position ? position - elapsed : 0;
+}
+
+bool PositionEstimator::apply(StatusReportData &report, uint32_t now) {
+    bool moving = false;
+    for (uint8_t i = 0; i < report.actuatorCount; i++) {
+        ActuatorData &actuator = report.actuators[i];
+        actuator.position = estimate(actuator, now);
+        // an actuator held at either end no longer changes until the Mega reports again.
+        uint32_t end = actuator.mode == LinkMode::EXTENDING ? limitOf(actuator) : 0;
+        moving |= isMoving(actuator) && actuator.position != end;
+    }
+    return moving;
+}
+
+} // namespace ActuatorsController
@@ -0,0 +1,53 @@
+//
+// ReportSnapshot.cpp
+// Description: Double-buffered seqlock for the link task's reports.
+//
+#include "esp32/ReportSnapshot.h"
+#include <string.h>
+
+namespace ActuatorsController {
+
+ReportSnapshot::ReportSnapshot() : current(0), publishCount(0), retryCount(0) {
+    for (Buffer &buffer : buffers) {
+        buffer.sequence.store(0, std::memory_order_relaxed);
+        buffer.publishNumber = 0;
+        memset(&buffer.report, 0, sizeof(buffer.report));
+    }
+}
+
+void ReportSnapshot::publish(const StatusReportData &report) {
+    uint8_t back = current.load(std::memory_order_relaxed) ^ 1;
+    Buffer &buffer = buffers[back];
+    uint32_t sequence = buffer.sequence.load(std::memory_order_relaxed);
+    buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+    // keeps the copy below from being seen before the odd counter.
+    std::atomic_thread_fence(std::memory_order_release);
+    uint32_t number = publishCount.load(std::memory_order_relaxed) + 1;
+    buffer.publishNumber = number;
+    memcpy(&buffer.report, &report, sizeof(report));
+    buffer.sequence.store(sequence + 2, std::memory_order_release);
+    current.store(back, std::memory_order_release);
+    publishCount.store(number, std::memory_order_release);
+}
+
+uint32_t ReportSnapshot::read(StatusReportData &report) const {
+    for (;;) {
+        const Buffer &buffer = buffers[current.load(std::memory_order_acquire)];
+        uint32_t before = buffer.sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            uint32_t number = buffer.publishNumber;
+            if (number == 0) {
+                return 0;
+            }
+            memcpy(&report, &buffer.report, sizeof(report));
+            // keeps the copy above from being moved after the second look at the counter.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer.sequence.load(std::memory_order_relaxed) == before) {
+                return number;
+            }
+        }
+        retryCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace ActuatorsController
@@ -16,18 +16,20 @@ StatusMonitor::StatusMonitor(StatusReportProcessor &processor)
 }
 
 // updateStatus:
-// Checks Serial2 for available data. If data is available, it reads input until newline,
-// parses the input into a StatusReportData object, and triggers the processor update.
-// Returns true if processing was successful.
+// Checks Serial2 for available data. If data is available, it decodes the frames received
+// so far into the StatusReportData object.  Called on every loop pass, so it stays quiet.
+// Returns true if the report changed.
 
 bool StatusMonitor::updateStatus() {
+  bool updated = false;
   if (Serial2.available() > 0) {
-    Serial.println("Serial2 data available");
-    // Let the StatusReportProcessor read from Serial2, parse the JSON,
+    // Let the StatusReportProcessor read from Serial2, decode the frames,
     // and update its internal StatusReportData structure.
-    return statusProcessor.process(Serial2);
+    updated = statusProcessor.process(Serial2);
   }
-  return false;
+  // A silent link is only noticed by time passing, so this is checked even without data.
+  updated |= statusProcessor.checkLinkState();
+  return updated;
 }
 
 // getFormattedStatus:
@@ -0,0 +1,47 @@
+//
+// UartRxEvents.cpp
+// Description: UART receive events and frame latency of the Mega link.
+//
+#include "esp32/UartRxEvents.h"
+
+namespace ActuatorsController {
+
+const uint32_t UartRxEvents::LATENCY_BOUNDS[LATENCY_BUCKETS - 1] = {250, 500, 1000, 2000, 5000};
+
+UartRxEvents::UartRxEvents(HardwareSerial &port) :
+    port(port), task(nullptr), lastEventMicros(0), eventCount(0), lastLatencyMicros(0), maxLatencyMicros(0),
+    latencyCounts() {}
+
+void UartRxEvents::configure() {
+    port.setRxBufferSize(RX_BUFFER_SIZE);
+}
+
+void UartRxEvents::attach(EspTask &linkTask) {
+    task = &linkTask;
+    port.setRxFIFOFull(RX_FIFO_FULL);
+    port.setRxTimeout(RX_TIMEOUT_SYMBOLS);
+    // runs in the core's UART event task, not in an interrupt.
+    port.onReceive([this]() {
+        lastEventMicros.store(micros(), std::memory_order_relaxed);
+        eventCount.fetch_add(1, std::memory_order_relaxed);
+        task->notify();
+    });
+}
+
+void UartRxEvents::noteFramesParsed() {
+    if (getEventCount() == 0) {
+        return;
+    }
+    uint32_t latency = micros() - lastEventMicros.load(std::memory_order_relaxed);
+    lastLatencyMicros = latency;
+    if (latency > maxLatencyMicros) {
+        maxLatencyMicros = latency;
+    }
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && latency >= LATENCY_BOUNDS[bucket]) {
+        bucket++;
+    }
+    latencyCounts[bucket]++;
+}
+
+} // namespace ActuatorsController
@@ -10,22 +10,33 @@
 
 // Constructor: Initialize all properties to empty strings.
 WebPageBuilder::WebPageBuilder(const String &defaultTitle)
-    : pageTitle(defaultTitle), cssLink(""), jsLink(""), navigationContent(""), dynamicBodyContent("")
+    : pageTitle(defaultTitle), cssLink(""), jsLink(""), navigationContent(""), dynamicBodyContent(""),
+      staticPartsCached(false)
 	{ }
     // Cleanup resources if needed.
 	WebPageBuilder::~WebPageBuilder() { }
     // Setters for page properties.
     void WebPageBuilder::setPageTitle(const String &title) {
       pageTitle = title;
+      invalidateStaticParts();
     }
     void WebPageBuilder::setCSSLink(const String &cssLinkValue) {
       cssLink = cssLinkValue;
+      invalidateStaticParts();
     }
     void WebPageBuilder::setJSLink(const String &jsLinkValue) {
       jsLink = jsLinkValue;
+      invalidateStaticParts();
     }
     void WebPageBuilder::setNavigation(const String &navContent) {
       navigationContent = navContent;
+      invalidateStaticParts();
+    }
+    void WebPageBuilder::invalidateStaticParts() {
+      staticPartsCached = false;
+      cachedHeader = "";
+      cachedNavigation = "";
+      cachedFooter = "";
     }
     void WebPageBuilder::clearBodyContent() {
       dynamicBodyContent = "";
@@ -40,18 +51,33 @@ WebPageBuilder::WebPageBuilder(const String &defaultTitle)
     // Build and return the complete HTML page.
     String WebPageBuilder::buildPage(const StatusReportData &statusData) {
     String page;
+    StringPageSink out(page);
+    writePage(out, statusData);
+    out.flush();
+    return page;
+  }
+    // Write the page into out: the cached header, navigation and footer around a body that
+    // is written piece by piece, so the page is never held whole.
+    void WebPageBuilder::writePage(PageSink &out, const StatusReportData &statusData) {
+    cacheStaticParts();
     // Append header section.
-    page += getHeader();
+    out.write(cachedHeader);
     // Append navigation if provided
-    page += getNavigation();
+    out.write(cachedNavigation);
     // Append dynamic body content
-    page += getBody(statusData);
+    bodyBuilder.writeBody(out, statusData);
     // Append footer
-    page += getFooter();
-
-    return page;
-
+    out.write(cachedFooter);
   }
+    void WebPageBuilder::cacheStaticParts() {
+      if (staticPartsCached) {
+        return;
+      }
+      cachedHeader = getHeader();
+      cachedNavigation = getNavigation();
+      cachedFooter = getFooter();
+      staticPartsCached = true;
+    }
   // Build the section: includes meta tags, title, and CSS/JS links.
   String WebPageBuilder::getHeader() {
       headerBuilder.setTitle(pageTitle);
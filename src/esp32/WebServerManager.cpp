@@ -4,11 +4,16 @@
 // WebServerManager.cpp
 
 #include "esp32/WebServerManager.h"
+// actuator numbering is shared with the Mega.
+#include "mega/inputmapping.h"
+#include "esp32/PositionEstimator.h"
 
 // Constructor: set up the server and default page content.
 WebServerManager::WebServerManager() : server(80) {
   // Set initial page content. This can be later updated using updatePageContent.
-  pageContent = "Windows Controller Interface";
+  for (uint8_t slot = 0; slot < LINK_MAX_NODES; slot++) {
+    pageContent[slot] = "Windows Controller Interface";
+  }
   // Setup the root route ("/") to call the handleRoot member.
   server.on("/", [this]()
             { handleRoot(); });
@@ -23,20 +28,426 @@ void WebServerManager::begin() {
 void WebServerManager::handleClient() {
   server.handleClient();
 }
-// Updates the current page content and reassigns the root route.
-void WebServerManager::updatePageContent(const String &newPageHTML) {
-  pageContent = newPageHTML;
-  // Re-setup the root route so that it serves the updated content.
-  server.on("/", [this]()
-            { handleRoot(); });
-  Serial.println("Web page content updated.");
+// Updates the current page content; the root route set up in the constructor serves it.
+void WebServerManager::updatePageContent(const String &newPageHTML, uint8_t node) {
+  if (node < LINK_FIRST_NODE || node - LINK_FIRST_NODE >= LINK_MAX_NODES) {
+    return;
+  }
+  pageContent[node - LINK_FIRST_NODE] = newPageHTML;
 }
 
 // Returns the current page HTML content.
 String WebServerManager::generateHTML() {
-  return pageContent;
+  return pageContent[0];
 }
 // Root route handler: sends the pageContent as the HTTP response.
 void WebServerManager::handleRoot() {
-  server.send(200, "text/html", pageContent);
+  uint8_t slot = requestedSlot();
+  if (slot == LINK_MAX_NODES) {
+    server.send(404, "text/plain", "unknown node");
+    return;
+  }
+  const ReportSnapshot *snapshot = reportSnapshots[slot];
+  StatusReportData report;
+  uint32_t publishNumber = 0;
+  if (pageBuilder != nullptr && snapshot != nullptr) {
+    publishNumber = snapshot->read(report);
+  }
+  if (publishNumber == 0) {
+    server.send(200, "text/html", pageContent[slot]);
+    return;
+  }
+  PositionEstimator::apply(report, millis());
+  streamPage(slot, report, publishNumber);
+}
+
+// Nobody pays for a page until someone asks for it, and then the builders write it into a
+// PageSink::CHUNK_SIZE buffer that goes out as each chunk fills, so the page is never held
+// whole, however many actuators it shows.
+void WebServerManager::streamPage(uint8_t slot, const StatusReportData &report, uint32_t publishNumber) {
+  ChunkedResponseSink out(server, "text/html");
+  pageBuilder->writePage(out, report);
+  out.finish();
+  pageTiming.renders++;
+  pageTiming.firstByteLast = out.getFirstByteTime();
+  if (pageTiming.firstByteLast > pageTiming.firstByteMax) {
+    pageTiming.firstByteMax = pageTiming.firstByteLast;
+  }
+  pageTiming.totalLast = out.getTotalTime();
+  pageTiming.bytesLast = out.getBytesWritten();
+  pageTiming.chunksLast = out.getChunkCount();
+  // from the Mega's event to the first page that shows it, once the clocks are synced.
+  if (publishNumber != pagePublishNumbers[slot] && report.timeSynced) {
+    notePageLatency(millis() - report.localTimestamp, slot);
+  }
+  pagePublishNumbers[slot] = publishNumber;
+}
+
+void WebServerManager::attachPageBuilder(WebPageBuilder &builder) {
+  pageBuilder = &builder;
+}
+
+uint8_t WebServerManager::requestedSlot() {
+  if (!server.hasArg("node")) {
+    return 0;
+  }
+  long node = server.arg("node").toInt();
+  if (node < LINK_FIRST_NODE || node - LINK_FIRST_NODE >= LINK_MAX_NODES) {
+    return LINK_MAX_NODES;
+  }
+  return static_cast<uint8_t>(node - LINK_FIRST_NODE);
+}
+
+// Registers the /command route, once, and an executor it forwards to.
+void WebServerManager::attachCommandExecutor(ActuatorCommandExecutor &executor) {
+  uint8_t slot = executor.getNode() - LINK_FIRST_NODE;
+  if (slot >= LINK_MAX_NODES) {
+    return;
+  }
+  bool first = true;
+  for (ActuatorCommandExecutor *attached : commandExecutors) {
+    first &= attached == nullptr;
+  }
+  commandExecutors[slot] = &executor;
+  if (first) {
+    server.on("/command", [this]()
+              { handleCommand(); });
+  }
+}
+
+// Command route handler: either sends a command or reports the state of a previous one.
+void WebServerManager::handleCommand() {
+  uint8_t slot = requestedSlot();
+  ActuatorCommandExecutor *commandExecutor = slot < LINK_MAX_NODES ? commandExecutors[slot] : nullptr;
+  if (commandExecutor == nullptr) {
+    server.send(404, "text/plain", "unknown node");
+    return;
+  }
+  if (server.hasArg("seq")) {
+    uint16_t sequence = server.arg("seq").toInt();
+    String state;
+    {
+      LinkLock::Guard guard(linkLock);
+      state = String(ActuatorCommandExecutor::stateName(commandExecutor->getState(sequence))) + " " +
+              commandExecutor->getStatus(sequence);
+    }
+    server.send(200, "text/plain", state);
+    return;
+  }
+  String action = server.arg("action");
+  action.toUpperCase();
+  String actuator = server.arg("actuator");
+  actuator.toUpperCase();
+  if (action.length() == 0) {
+    server.send(400, "text/plain", "missing action");
+    return;
+  }
+  // the Mega validates the command too; checking here gives the browser a direct answer.
+  const CommandSpec *spec = findCommand(action.c_str(), action.length());
+  if (spec == nullptr) {
+    server.send(400, "text/plain", "unknown action");
+    return;
+  }
+  uint8_t actuatorNumber = ALL_ACTUATORS;
+  if (spec->argument == ArgumentKind::ACTUATOR_OR_ALL && actuator != "ALL") {
+    long number = actuator.toInt();
+    if (number < 1 || number > TOTAL_ACTUATORS) {
+      server.send(400, "text/plain", "bad actuator");
+      return;
+    }
+    actuatorNumber = static_cast<uint8_t>(number);
+  }
+  uint16_t sequence;
+  {
+    LinkLock::Guard guard(linkLock);
+    sequence = commandExecutor->send(spec->opcode, actuatorNumber);
+  }
+  if (sequence == 0) {
+    server.send(500, "text/plain", "command not sent");
+    return;
+  }
+  server.send(202, "text/plain", String(sequence));
+}
+
+// String() has no 64-bit overload on every core; Unix ms need one.
+static String uint64ToString(uint64_t value) {
+  char digits[21];
+  char *end = digits + sizeof(digits) - 1;
+  char *start = end;
+  *end = '\0';
+  do {
+    *--start = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  return String(start);
+}
+
+// Registers the /status route, once, and a Mega's snapshot it reports from.
+void WebServerManager::attachReportSnapshot(const ReportSnapshot &snapshot, uint8_t node) {
+  uint8_t slot = node - LINK_FIRST_NODE;
+  if (slot >= LINK_MAX_NODES) {
+    return;
+  }
+  bool first = true;
+  for (const ReportSnapshot *attached : reportSnapshots) {
+    first &= attached == nullptr;
+  }
+  reportSnapshots[slot] = &snapshot;
+  if (first) {
+    server.on("/status", [this]()
+              { handleStatus(); });
+  }
+}
+
+// Status handler: "name value" per line, "actuator_<index>_<field>" for each actuator the
+// Mega has reported.  Positions are estimated for the moment of the request.
+void WebServerManager::handleStatus() {
+  uint8_t slot = requestedSlot();
+  const ReportSnapshot *snapshot = slot < LINK_MAX_NODES ? reportSnapshots[slot] : nullptr;
+  if (snapshot == nullptr) {
+    server.send(404, "text/plain", "unknown node");
+    return;
+  }
+  StatusReportData report;
+  if (snapshot->read(report) == 0) {
+    server.send(503, "text/plain", "no report yet");
+    return;
+  }
+  PositionEstimator::apply(report, millis());
+  String body;
+  body += "node " + String(slot + LINK_FIRST_NODE) + "\n";
+  body += "timestamp " + String(report.timestamp) + "\n";
+  body += "force_mode " + String(report.forceMode ? 1 : 0) + "\n";
+  // how old the report is as this response leaves, from the Mega's own timestamp.
+  if (report.timeSynced) {
+    body += "wall_ms " + uint64ToString(report.wallTime) + "\n";
+    body += "age_ms " + String(static_cast<uint32_t>(millis()) - report.localTimestamp) + "\n";
+  }
+  for (uint8_t i = 0; i < report.actuatorCount; i++) {
+    const ActuatorData &actuator = report.actuators[i];
+    if (actuator.generation == 0) {
+      continue;
+    }
+    String prefix = "actuator_" + String(actuator.index) + "_";
+    body += prefix + "active " + String(actuator.active ? 1 : 0) + "\n";
+    body += prefix + "mode " + StatusReportProcessor::modeName(actuator.mode) + "\n";
+    body += prefix + "position " + String(actuator.position) + "\n";
+    body += prefix + "max_duration " + String(actuator.maxDuration) + "\n";
+    if (actuator.wallTime != 0) {
+      body += prefix + "wall_ms " + uint64ToString(actuator.wallTime) + "\n";
+    }
+  }
+  server.send(200, "text/plain", body);
+}
+
+// Registers the /link route, once, and a processor whose counters it reports.
+void WebServerManager::attachLinkDiagnostics(const StatusReportProcessor &processor) {
+  uint8_t slot = processor.getNode() - LINK_FIRST_NODE;
+  if (slot >= LINK_MAX_NODES) {
+    return;
+  }
+  bool first = true;
+  for (const StatusReportProcessor *attached : linkProcessors) {
+    first &= attached == nullptr;
+  }
+  linkProcessors[slot] = &processor;
+  if (first) {
+    server.on("/link", [this]()
+              { handleLinkDiagnostics(); });
+  }
+}
+
+void WebServerManager::attachLinkBus(LinkBus &bus) {
+  linkBus = &bus;
+}
+
+void WebServerManager::attachRxEvents(const UartRxEvents &events) {
+  rxEvents = &events;
+}
+
+void WebServerManager::notePageLatency(uint32_t latency, uint8_t slot) {
+  pageLatencies[slot].last = latency;
+  if (latency > pageLatencies[slot].max) {
+    pageLatencies[slot].max = latency;
+  }
+}
+
+void WebServerManager::attachLinkLock(LinkLock &lock) {
+  linkLock = &lock;
+}
+
+// Registers the /tasks route, once, and a task it reports on.
+void WebServerManager::attachTask(const EspTask &task) {
+  if (taskCount == MAX_TASKS) {
+    return;
+  }
+  tasks[taskCount++] = &task;
+  if (taskCount == 1) {
+    server.on("/tasks", [this]()
+              { handleTasks(); });
+  }
+}
+
+// Link diagnostics handler: one "name value" pair per line.  On a bus the frame counters
+// are the bus's, since one decoder reads for every node.
+void WebServerManager::handleLinkDiagnostics() {
+  uint8_t slot = requestedSlot();
+  const StatusReportProcessor *linkProcessor = slot < LINK_MAX_NODES ? linkProcessors[slot] : nullptr;
+  if (linkProcessor == nullptr) {
+    server.send(404, "text/plain", "unknown node");
+    return;
+  }
+  ActuatorCommandExecutor *commandExecutor = commandExecutors[slot];
+  // the link task's counters are copied while it is kept out, so they are consistent with
+  // each other, and formatted once it can run again; building the body allocates.
+  uint8_t nodeAddress;
+  LinkFrameDecoder decoder;
+  uint16_t gaps, lateFrames, resyncRequests, snapshotRequests, linkDowns;
+  uint32_t missedFrames, lastEventLatency, maxEventLatency;
+  unsigned long lastDecodeMicros, maxDecodeMicros;
+  bool linkUp;
+  LinkHeartbeat heartbeat(0);
+  LinkClockSync clockSync;
+  bool hasNegotiator;
+  uint32_t baud = 0, baudCeiling = 0;
+  uint16_t baudTries = 0, baudFailedTries = 0, baudErrorFallbacks = 0, baudSilenceFallbacks = 0;
+  bool onBus;
+  uint8_t busNodes = 0;
+  uint32_t busRounds = 0, busPolls = 0, busPollTimeouts = 0;
+  unsigned long busLastRoundMillis = 0;
+  uint16_t busStrayFrames = 0, busOutboxDrops = 0;
+  uint16_t commandsAcked = 0, commandsNaked = 0, commandsTimedOut = 0;
+  {
+    LinkLock::Guard guard(linkLock);
+    nodeAddress = linkProcessor->getNode();
+    decoder = linkBus != nullptr ? linkBus->getDecoder() : linkProcessor->getDecoder();
+    gaps = linkProcessor->getGapCount();
+    missedFrames = linkProcessor->getMissedFrameCount();
+    lateFrames = linkProcessor->getLateFrameCount();
+    resyncRequests = linkProcessor->getResyncRequestCount();
+    snapshotRequests = linkProcessor->getSnapshotRequestCount();
+    lastDecodeMicros = linkProcessor->getLastDecodeMicros();
+    maxDecodeMicros = linkProcessor->getMaxDecodeMicros();
+    linkUp = linkProcessor->isLinkUp();
+    linkDowns = linkProcessor->getLinkDownCount();
+    heartbeat = linkProcessor->getHeartbeat();
+    clockSync = linkProcessor->getClockSync();
+    lastEventLatency = linkProcessor->getLastEventLatency();
+    maxEventLatency = linkProcessor->getMaxEventLatency();
+    const LinkRateNegotiator *negotiator = linkProcessor->getRateNegotiator();
+    hasNegotiator = negotiator != nullptr;
+    if (hasNegotiator) {
+      baud = negotiator->getBaudRate();
+      baudCeiling = negotiator->getCeiling();
+      baudTries = negotiator->getTryCount();
+      baudFailedTries = negotiator->getFailedTryCount();
+      baudErrorFallbacks = negotiator->getErrorFallbackCount();
+      baudSilenceFallbacks = negotiator->getSilenceFallbackCount();
+    }
+    LinkNode *node = linkBus != nullptr ? linkBus->findNode(nodeAddress) : nullptr;
+    onBus = node != nullptr;
+    if (onBus) {
+      busNodes = linkBus->getNodeCount();
+      busRounds = linkBus->getRoundCount();
+      busLastRoundMillis = linkBus->getLastRoundMillis();
+      busStrayFrames = linkBus->getStrayFrameCount();
+      busPolls = node->pollCount;
+      busPollTimeouts = node->timeoutCount;
+      busOutboxDrops = node->outbox.getDroppedCount();
+    }
+    if (commandExecutor != nullptr) {
+      commandsAcked = commandExecutor->getAckedCount();
+      commandsNaked = commandExecutor->getNakedCount();
+      commandsTimedOut = commandExecutor->getTimeoutCount();
+    }
+  }
+
+  String body;
+  body += "node " + String(nodeAddress) + "\n";
+  body += "frames " + String(decoder.getFrameCount()) + "\n";
+  body += "crc_errors " + String(decoder.getCrcErrorCount()) + "\n";
+  body += "format_errors " + String(decoder.getFormatErrorCount()) + "\n";
+  body += "version_errors " + String(decoder.getVersionErrorCount()) + "\n";
+  body += "gaps " + String(gaps) + "\n";
+  body += "missed_frames " + String(missedFrames) + "\n";
+  body += "late_frames " + String(lateFrames) + "\n";
+  body += "resync_requests " + String(resyncRequests) + "\n";
+  body += "snapshot_requests " + String(snapshotRequests) + "\n";
+  body += "last_decode_us " + String(lastDecodeMicros) + "\n";
+  body += "max_decode_us " + String(maxDecodeMicros) + "\n";
+  if (rxEvents != nullptr) {
+    body += "rx_events " + String(rxEvents->getEventCount()) + "\n";
+    body += "rx_latency_last_us " + String(rxEvents->getLastLatencyMicros()) + "\n";
+    body += "rx_latency_max_us " + String(rxEvents->getMaxLatencyMicros()) + "\n";
+    for (uint8_t bucket = 0; bucket < UartRxEvents::LATENCY_BUCKETS; bucket++) {
+      String bound = bucket < UartRxEvents::LATENCY_BUCKETS - 1 ? "lt_" + String(UartRxEvents::LATENCY_BOUNDS[bucket])
+                                                                : "ge_" + String(UartRxEvents::LATENCY_BOUNDS[bucket - 1]);
+      body += "rx_latency_us_" + bound + " " + String(rxEvents->getLatencyCount(bucket)) + "\n";
+    }
+  }
+  body += "link_up " + String(linkUp ? 1 : 0) + "\n";
+  body += "link_downs " + String(linkDowns) + "\n";
+  body += "mega_boot_id " + String(heartbeat.getPeerBootId()) + "\n";
+  body += "mega_restarts " + String(heartbeat.getPeerRestartCount()) + "\n";
+  body += "rtt_last_ms " + String(heartbeat.getLastRtt()) + "\n";
+  body += "clock_synced " + String(clockSync.isSynced() ? 1 : 0) + "\n";
+  body += "clock_wall_synced " + String(LinkClockSync::wallClockNow() != 0 ? 1 : 0) + "\n";
+  body += "clock_offset_ms " + String(clockSync.getOffset()) + "\n";
+  body += "clock_drift_ppm " + String(clockSync.getDriftPpm()) + "\n";
+  body += "clock_rtt_ms " + String(clockSync.getBestRtt()) + "\n";
+  body += "clock_samples " + String(clockSync.getSampleCount()) + "\n";
+  body += "event_latency_last_ms " + String(lastEventLatency) + "\n";
+  body += "event_latency_max_ms " + String(maxEventLatency) + "\n";
+  body += "page_latency_last_ms " + String(pageLatencies[slot].last) + "\n";
+  body += "page_latency_max_ms " + String(pageLatencies[slot].max) + "\n";
+  body += "page_renders " + String(pageTiming.renders) + "\n";
+  body += "page_first_byte_last_us " + String(pageTiming.firstByteLast) + "\n";
+  body += "page_first_byte_max_us " + String(pageTiming.firstByteMax) + "\n";
+  body += "page_total_last_us " + String(pageTiming.totalLast) + "\n";
+  body += "page_bytes_last " + String(pageTiming.bytesLast) + "\n";
+  body += "page_chunks_last " + String(pageTiming.chunksLast) + "\n";
+  // histogram buckets are named by their upper bound; the last one is open ended.
+  for (uint8_t bucket = 0; bucket < LinkHeartbeat::RTT_BUCKETS; bucket++) {
+    String bound = bucket < LinkHeartbeat::RTT_BUCKETS - 1 ? "lt_" + String(2UL << bucket) : "ge_" + String(1UL << bucket);
+    body += "rtt_ms_" + bound + " " + String(heartbeat.getRttCount(bucket)) + "\n";
+  }
+  if (hasNegotiator) {
+    body += "baud " + String(baud) + "\n";
+    body += "baud_ceiling " + String(baudCeiling) + "\n";
+    body += "baud_tries " + String(baudTries) + "\n";
+    body += "baud_failed_tries " + String(baudFailedTries) + "\n";
+    body += "baud_error_fallbacks " + String(baudErrorFallbacks) + "\n";
+    body += "baud_silence_fallbacks " + String(baudSilenceFallbacks) + "\n";
+  }
+  if (onBus) {
+    body += "bus_nodes " + String(busNodes) + "\n";
+    body += "bus_rounds " + String(busRounds) + "\n";
+    body += "bus_last_round_ms " + String(busLastRoundMillis) + "\n";
+    body += "bus_stray_frames " + String(busStrayFrames) + "\n";
+    body += "bus_polls " + String(busPolls) + "\n";
+    body += "bus_poll_timeouts " + String(busPollTimeouts) + "\n";
+    body += "bus_outbox_drops " + String(busOutboxDrops) + "\n";
+  }
+  if (commandExecutor != nullptr) {
+    body += "commands_acked " + String(commandsAcked) + "\n";
+    body += "commands_naked " + String(commandsNaked) + "\n";
+    body += "commands_timed_out " + String(commandsTimedOut) + "\n";
+  }
+  server.send(200, "text/plain", body);
+}
+
+// Tasks handler: "<task>_<counter> value" per line; load is in tenths of a percent of the
+// task's last one second window, stack_free the least stack it has had left, in bytes.
+void WebServerManager::handleTasks() {
+  String body;
+  for (uint8_t i = 0; i < taskCount; i++) {
+    const EspTask &task = *tasks[i];
+    String prefix = String(task.getName()) + "_";
+    body += prefix + "core " + String(task.getCore()) + "\n";
+    body += prefix + "priority " + String(task.getPriority()) + "\n";
+    body += prefix + "load_permille " + String(task.getLoadPermille()) + "\n";
+    body += prefix + "max_step_us " + String(task.getMaxStepMicros()) + "\n";
+    body += prefix + "stack_free " + String(task.getStackHighWater()) + "\n";
+  }
+  server.send(200, "text/plain", body);
 }
@@ -11,10 +11,17 @@
 #include "espconfig.h"
 #include <ArduinoOTA.h>
 #include "esp32/esp32Config.h"
+#include "esp32/EspLog.h"
 #include "esp32/StatusReportProcessor.h"
 #include "esp32/WebPageBuilder.h"
 #include "esp32/StatusMonitor.h"
 #include "esp32/WebServerManager.h"
+#include "esp32/ActuatorCommandExecutor.h"
+#include "esp32/LinkRateNegotiator.h"
+#include "esp32/LinkBus.h"
+#include "esp32/EspTask.h"
+#include "esp32/ReportSnapshot.h"
+#include "esp32/UartRxEvents.h"
 
   using namespace ActuatorsController;
 
@@ -32,10 +39,6 @@
 
 #define LED_BUILTIN 2 // Define LED_BUILTIN if it's not defined
 
-  unsigned long lastStatusMillis = 0;
-  unsigned long currentMillis = 0;
-  const unsigned long statusInterval = 500; // 500ms
-
   enum ActuatorStatus { INACTIVE, EXTENDING, RETRACTING };
   ActuatorStatus actuatorStatus[4] = { INACTIVE, INACTIVE, INACTIVE, INACTIVE };
 
@@ -153,9 +156,31 @@
   WebServerManager webServerManager;
   // Instantiate OTAUpdater globally (alongside WiFiManager and WebServerManager)
   OTAUpdater otaUpdater;
+  ActuatorCommandExecutor commandExecutor(Serial2);
+  LinkRateNegotiator linkRateNegotiator(Serial2);
   StatusReportProcessor statusProcessor(Serial2);
   StatusMonitor statusMonitor(statusProcessor);
   WebPageBuilder webPageBuilder("Windows Controller Interface");
+#ifdef LINK_RS485_DE_PIN
+  // One LinkNode per Mega on the bus, by the node address set in its mega2560_main.cpp.
+  LinkBus linkBus(Serial2, LINK_RS485_DE_PIN);
+  LinkNode busNode1(LINK_FIRST_NODE);
+  LinkNode busNode2(LINK_FIRST_NODE + 1);
+#endif
+  // Link ingestion and parsing run on core 1, above the Arduino loop task.  HTTP, WiFi, OTA
+  // and the console log run on core 0, next to the WiFi stack, so a slow client or a WiFi
+  // reconnect no longer holds up the link.  The link task publishes each Mega's report in
+  // its snapshot, by node, which the web task copies without a lock; /command and /link take
+  // linkLock.  The link task
+  // wakes as soon as Serial2 has data, and at least every tick for timers.
+  EspTask linkTask("link", 4096, 3, 1, 1);
+  EspTask webTask("web", 8192, 2, 0, 2);
+  LinkLock linkLock;
+  UartRxEvents linkRxEvents(Serial2);
+  ReportSnapshot reportSnapshots[LINK_MAX_NODES];
+
+  void linkStep(void *);
+  void webStep(void *);
 
 
   void WiFiManager::connectToWiFi() {
@@ -177,6 +202,8 @@
       // Print the IP address
       Serial.print("ESP32 IP Address: ");
       Serial.println(WiFi.localIP());
+      // Wall-clock time for the Mega's timestamps, in UTC; SNTP keeps it in the background.
+      configTime(0, 0, "pool.ntp.org");
       // Announce service to mDNS
       if (!MDNS.begin("esp32")) { // Set the hostname to "esp32"
         Serial.println("Error setting up MDNS responder!");
@@ -201,12 +228,39 @@
 
   void setup() {
     Serial.begin(115200);      // Serial communication with the computer
-    Serial2.begin(115200, SERIAL_8N1, RX_PIN, TX_PIN); // Serial communication with Arduino Mega (RX, TX)
+    // Serial communication with Arduino Mega (RX, TX); the rate is raised once a faster one tests clean.
+    linkRxEvents.configure();
+    Serial2.begin(LINK_BAUD_RATES[0], SERIAL_8N1, RX_PIN, TX_PIN);
+    linkRxEvents.attach(linkTask);
 
     pinMode(LED_BUILTIN, OUTPUT);  // Optional: Use built-in LED for testing
 
     //  btManager.begin();
     wifiManager.connectToWiFi();
+#ifdef LINK_RS485_DE_PIN
+    // the bus stays at the starting rate; every node would have to follow a change.
+    linkBus.addNode(busNode1);
+    linkBus.addNode(busNode2);
+    linkBus.begin();
+    for (uint8_t i = 0; i < linkBus.getNodeCount(); i++) {
+      LinkNode &node = linkBus.getNodeAt(i);
+      webServerManager.attachCommandExecutor(node.executor);
+      webServerManager.attachLinkDiagnostics(node.processor);
+      webServerManager.attachReportSnapshot(reportSnapshots[node.address - LINK_FIRST_NODE], node.address);
+    }
+    webServerManager.attachLinkBus(linkBus);
+#else
+    statusProcessor.attachCommandExecutor(commandExecutor);
+    statusProcessor.attachRateNegotiator(linkRateNegotiator);
+    webServerManager.attachCommandExecutor(commandExecutor);
+    webServerManager.attachLinkDiagnostics(statusProcessor);
+    webServerManager.attachReportSnapshot(reportSnapshots[0]);
+#endif
+    webServerManager.attachPageBuilder(webPageBuilder);
+    webServerManager.attachRxEvents(linkRxEvents);
+    webServerManager.attachLinkLock(linkLock);
+    webServerManager.attachTask(linkTask);
+    webServerManager.attachTask(webTask);
     webServerManager.begin();
     otaUpdater.beginOTA();
 
@@ -218,46 +272,57 @@
     Serial.print ("/**  Debug Level: ");
     Serial.println (DEBUG_LEVEL);
     Serial.println ("/**\n/**  ESP32 Started\n/**\n");
-    /** Send a communication to Mega board so it knows we just started **/
-    Serial2.println ("ESP32 Booted and Connected.");
+
+    linkTask.start(linkStep, nullptr);
+    webTask.start(webStep, nullptr);
   }
 
 
+// Everything runs in linkTask and webTask, so the Arduino loop task is not needed.
 void loop() {
-    currentMillis = millis();
-    // Process any pending WiFi and client requests.
+    vTaskDelete(nullptr);
+}
+
+
+// One pass of the link task: reads the Mega link and publishes reports that changed.
+void linkStep(void *) {
+    LinkLock::Guard guard(&linkLock);
+#ifdef LINK_RS485_DE_PIN
+    const LinkFrameDecoder &decoder = linkBus.getDecoder();
+    uint16_t frames = decoder.getFrameCount();
+    // Polls the next Mega whenever the previous one has finished its turn.
+    if (linkBus.update()) {
+      for (uint8_t i = 0; i < linkBus.getNodeCount(); i++) {
+        LinkNode &node = linkBus.getNodeAt(i);
+        reportSnapshots[node.address - LINK_FIRST_NODE].publish(node.processor.getReport());
+      }
+    }
+#else
+    const LinkFrameDecoder &decoder = statusProcessor.getDecoder();
+    uint16_t frames = decoder.getFrameCount();
+    commandExecutor.expirePending();
+    statusProcessor.serviceHeartbeat();
+    // Read Serial2 every pass so baud probes are answered in time and the UART buffer never
+    // fills up.
+    if (statusMonitor.updateStatus()) {
+      reportSnapshots[0].publish(statusMonitor.getStatusReport());
+    }
+    linkRateNegotiator.update(statusProcessor.getHeartbeat(), statusProcessor.getDecoder());
+#endif
+    if (decoder.getFrameCount() != frames) {
+      linkRxEvents.noteFramesParsed();
+    }
+}
+
+
+// One pass of the web task: serves clients, which render pages from the snapshots as they
+// ask for them, and keeps WiFi, OTA and the console log going.
+void webStep(void *) {
     wifiManager.handleWiFi();
     webServerManager.handleClient();
     otaUpdater.handleOTA();
-    // Update status every statusInterval milliseconds.
-    if (currentMillis - lastStatusMillis >= statusInterval) {
-      lastStatusMillis = currentMillis;
-      // Update the status from Serial2 data.
-      if (statusMonitor.updateStatus()) {
-        // Retrieve the structured status report
-        const StatusReportData &statusData = statusMonitor.getStatusReport();
-        // Build the HTML page using the updated status data.
-        String pageHTML = webPageBuilder.buildPage(statusData);
-
-/** begin debug **/
-        if (&statusData != nullptr) {
-          String out = "";
-          out += String(statusData.timestamp) + ",";
-          for (uint8_t i = 0; i < statusData.actuatorCount; i++) {
-            // Assume each actuator provides a way to convert to a string.
-            out += String(statusData.actuators[i].index) +  ": " + String(statusData.actuators[i].name);
-            if (i < statusData.actuatorCount - 1) { out += ";"; }
-          }
-          out += "," + statusData.statusMessage;
-          Serial.println(out);
-        }
-
-/** end debug **/
-        // if (pageHTML.length() > 0) { Serial.println(pageHTML);}
-        // Set or update the web server’s dynamic content.
-        webServerManager.updatePageContent(pageHTML);
-      }
-    }
+    // Log records are only formatted here, and only as fast as Serial's TX buffer drains.
+    espLog.drain(Serial);
 }
 
 
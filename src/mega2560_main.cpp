@@ -8,14 +8,38 @@
 #include "mega/MegaButton.h"
 #include "mega/MegaLEDControl.h"
 #include "mega/MegaCommand.h"
+#include "mega/MegaCommandReceiver.h"
+#include "mega/MegaLink.h"
+#include "mega/MegaLinkBus.h"
+#include "mega/MegaLinkReceiver.h"
+#include "mega/MegaLinkRate.h"
 #include "mega/MegaActuatorController.h"
 #include "mega/MegaInputManager.h"
 #include "mega/MegaStateWatcher.h"
+#include "mega/MegaTrace.h"
+#include "mega/MegaTxScheduler.h"
 //#include "MegaSwitch.h"
 
 using namespace ActuatorsController;
 
 
+// Address of this Mega on the link.  Each Mega sharing an RS-485 bus needs its own, from
+// LINK_FIRST_NODE up; the ESP32 polls them in turn.
+const uint8_t linkNode = LINK_FIRST_NODE;
+// Transceiver DE/RE pin when Serial2 is an RS-485 bus shared with other Megas; -1 for a
+// direct link to the ESP32.
+const int8_t linkBusDePin = -1;
+
+// Non-blocking transmit queues; bytes per priority class are SAFETY, STATE, PERIODIC, DEBUG.
+// An encoded status frame covering every relay is about 70 bytes.
+MegaTxChannel<128, 256, 256, 0> linkTx(Serial2);
+MegaLink link(linkTx, linkNode);
+MegaLinkBus linkBus(Serial2, linkTx, link, linkBusDePin);
+MegaTxChannel<0, 0, 0, 512> debugTx(Serial);
+MegaTxPrint ActuatorsController::debugSerial(debugTx, TxPriority::DEBUG);
+// Debug events go to the console as binary records; decode them with tools/trace_decode.py.
+MegaTrace ActuatorsController::megaTrace(debugTx);
+
 // Pin setup and object instantiation
 const int extendLedPin = 11; // 
 const int retractLedPin = 10; // 
@@ -28,8 +52,15 @@ MegaRelayControl relays;  // Creating an instance of MegaRelayControl
 // Initialize the MegaActuatorController instance
 MegaActuatorController actuatorController(relays, leds);
 
+// Commands from the ESP32 link and the USB console are framed incrementally and queued for the controller.
+MegaCommandQueue commandQueue;
+MegaLinkReceiver linkReceiver(Serial2, commandQueue, link, MegaLinkReceiver::nextBootId());
+// Serial2 starts at the slowest link rate; the ESP32 raises it once it has tested a faster one.
+MegaLinkRate linkRate(Serial2, linkTx, link);
+MegaCommandReceiver consoleReceiver(Serial, commandQueue, debugSerial);
+
 MegaInputManager inputManager;  // Create an instance of MegaInputManager
-ActuatorReporter statusReporter = ActuatorReporter(relays);
+ActuatorReporter statusReporter(relays, link);
 MegaStateWatcher stateWatcher(relays, statusReporter);
 // Create an instance (adjust the pin and interval as needed)
 Debounced mySwitch(2, 50); // Pin 2 with 50ms debounce time
@@ -40,29 +71,39 @@ const String KitchenScriptVersion = "KitchenWindows V1.21";
 void setup() {
     // Setup code here, if needed
     Serial.begin(115200);  // Start serial communication at 115200 baud
-    Serial2.begin(115200);   // Serial communication with ESP-32
+    Serial2.begin(LINK_BAUD_RATES[0]);   // Serial communication with ESP-32
    // Serial2 uses RX (Pin 17) and TX (Pin 16) on Arduino Mega 2560
     relays.initializeRelays(); // Initialize all relays to off
+    actuatorController.attachReporter(statusReporter);
+    linkBus.begin();
+    linkReceiver.attachBus(linkBus);
+    // the bus runs at a fixed rate shared by every node.
+    if (!linkBus.isMultidrop()) {
+        linkReceiver.attachRateControl(linkRate);
+    }
+    // Stream positions of moving actuators 10 times a second, using at most about an eighth of the link.
+    stateWatcher.setStreamInterval(100);
+    stateWatcher.setStreamBudget(1500);
 
-    Serial.print ("\n\n/**\n/**\n/**  Version: ");
-    Serial.println (KitchenScriptVersion);
-    Serial.println ("/**  Script restarted on Mega board.\n/**\n/**\n");
+    debugSerial.print ("\n\n/**\n/**\n/**  Version: ");
+    debugSerial.println (KitchenScriptVersion);
+    debugSerial.println ("/**  Script restarted on Mega board.\n/**\n/**\n");
 }
 
 void loop() {
     mySwitch.update();
     //inputManager.updateInputs();
     if (mySwitch.isPressed() && mySwitch.stateChanged()) {
-        Serial.println("Switch pressed");
+        trace<TraceId::SWITCH_PRESSED>();
         mySwitch.acknowledgeState();
     }
     ButtonState extendButtonState = inputManager.extendButton.getButtonState();
     ButtonState retractButtonState = inputManager.retractButton.getButtonState();
     if (extendButtonState == ButtonState::DOUBLE_PRESSED) {
-        Serial.println("\nDouble-press detected on extend button");
+        trace<TraceId::EXTEND_BUTTON_DOUBLE>();
         relays.forceOperation(true); // true for extend
     } else if (extendButtonState == ButtonState::SINGLE_PRESSED) {
-        Serial.println("\nState changed to extend");
+        trace<TraceId::EXTEND_BUTTON>();
         if (relays.anyActive()) {
             relays.pauseAll();
             leds.setFullBrightness(false, false);
@@ -72,31 +113,31 @@ void loop() {
             leds.setFullBrightness(true, true);
         }
     } else if (retractButtonState == ButtonState::DOUBLE_PRESSED) {
-        Serial.println("\nDouble-press detected on retract button");
+        trace<TraceId::RETRACT_BUTTON_DOUBLE>();
         relays.forceOperation(false);  // false for retract
     } else if (retractButtonState == ButtonState::SINGLE_PRESSED) {
-      Serial.println("\nState changed to retract");
+      trace<TraceId::RETRACT_BUTTON>();
       if (relays.anyActive()) {
         relays.pauseAll();
         leds.setFullBrightness(false, false);
       } else {
- //       Serial.println("State changed to retract");
+ //       debugSerial.println("State changed to retract");
         relays.controlRelays(false);  // Retract relays
       }
     }
     if (!relays.anyActive()) {
-//        Serial.println("No relays active");
+//        debugSerial.println("No relays active");
  //       leds.checkNightMode(simulatedHour);
         leds.updateBlink(millis());
     } else {
         if (relays.areAnyExtending()) {
-//            Serial.println("Some relays are extending");
+//            debugSerial.println("Some relays are extending");
             leds.setFullBrightness(true, true);
         } else if (relays.areAnyRetracting()) {
- //           Serial.println("Some relays are retracting");
+ //           debugSerial.println("Some relays are retracting");
             leds.setFullBrightness(true, false);
         } else {
- //           Serial.println("Active relays are neither extending nor retracting");
+ //           debugSerial.println("Active relays are neither extending nor retracting");
         }
     }
 
@@ -106,19 +147,16 @@ for (int i = 0; i < MAX_RELAY_PINS; ++i) {
     if (inputManager.getSwitchState(i) == ButtonState::SINGLE_PRESSED) {
         // Check if this is a double-flick indicating a FORCE Extend/Retract command.
         if (inputManager.isSwitchDoubleFlick(i) == ButtonState::DOUBLE_PRESSED) {
-            Serial.print("Force Extend/Retract command detected on switch on pin ");
-            Serial.println(i);
+            trace<TraceId::SWITCH_FORCE>(i);
             // extend or retract this only this pin using the force
             relays.forceOperator(i);  // false for retract
         } else if (currentState == ButtonState::SINGLE_PRESSED) {
             // Activate the corresponding actuator
-            Serial.print("Activating actuator for switch on pin ");
-            Serial.println(i);
+            trace<TraceId::SWITCH_ACTIVATE>(i);
             relays.controlSingleActuator(i);
         } else {
             // Pause or deactivate the corresponding actuator
-            Serial.print("Pausing actuator for switch on pin ");
-            Serial.println(i);
+            trace<TraceId::SWITCH_PAUSE>(i);
             relays.pauseSingleActuator(i);
         }
     }
@@ -127,22 +165,15 @@ for (int i = 0; i < MAX_RELAY_PINS; ++i) {
 
 
 
-    // Read commands from Serial1 (from ESP32) and execute them
-    if (Serial2.available()) {
-        String commandStr = Serial2.readStringUntil('\n');
-        commandStr.trim(); // Remove any extraneous whitespace or newline characters
-        if (commandStr.length() > 0) {
-            MegaCommand command(commandStr);
-            Serial.print ("Received command: ");
-            Serial.println (commandStr);
-            actuatorController.executeCommand(command);
-        }
-    } else {
-//      Serial.println ("Error: Serial1 (ESP32) not available.");
-//      delay (2000);
-    }
+    // Read commands from Serial2 (from ESP32) and the console without blocking and execute any complete ones
+    linkReceiver.poll();
+    consoleReceiver.poll();
+    actuatorController.processCommands(commandQueue);
     relays.update();  // Update relay states
     stateWatcher.checkAndReport();
+    // Hand queued frames to the UARTs without waiting on them; on a bus only in this node's turn.
+    linkBus.service();
+    debugTx.service();
 
 }
 
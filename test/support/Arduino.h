@@ -0,0 +1,230 @@
+//
+// Arduino.h
+// Description: Host stand-in for the Arduino core, for the native test environment.
+//
+// Only what the firmware headers use is provided.  Time does not pass on its own: tests
+// move hostMillis and hostMicros forward, so they run the same on every machine.  Serial
+// ports do nothing; a test derives from HardwareSerial to watch or feed one.
+//
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define noInterrupts()
+#define interrupts()
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+inline unsigned long hostMillis = 0;
+inline unsigned long hostMicros = 0;
+inline int hostPins[100];
+
+inline unsigned long millis() { return hostMillis; }
+inline unsigned long micros() { return hostMicros; }
+// Moves both clocks forward together.
+inline void hostAdvance(unsigned long ms) {
+    hostMillis += ms;
+    hostMicros += ms * 1000UL;
+}
+inline void delay(unsigned long ms) { hostAdvance(ms); }
+inline void delayMicroseconds(unsigned int) {}
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int value) {
+    if (pin >= 0) {
+        hostPins[pin] = value;
+    }
+}
+inline int digitalRead(int pin) { return pin >= 0 ? hostPins[pin] : LOW; }
+inline void analogWrite(int, int) {}
+inline long random(long low, long high) { return low + rand() % (high - low); }
+inline uint8_t pgm_read_byte(const void *address) { return *static_cast<const uint8_t *>(address); }
+inline uint16_t pgm_read_word(const void *address) { return *static_cast<const uint16_t *>(address); }
+
+class __FlashStringHelper;
+
+class String {
+public:
+    String() {}
+    String(const char *text) : text(text != nullptr ? text : "") {}
+    String(const char *text, size_t length) : text(text, length) {}
+    String(char c) : text(1, c) {}
+    String(int value, int base = DEC) : text(format(base == HEX ? "%x" : "%d", value)) {}
+    String(unsigned int value, int base = DEC) : text(format(base == HEX ? "%x" : "%u", value)) {}
+    String(long value, int base = DEC) : text(format(base == HEX ? "%lx" : "%ld", value)) {}
+    String(unsigned long value, int base = DEC) : text(format(base == HEX ? "%lx" : "%lu", value)) {}
+    String(unsigned char value, int base = DEC) : String(static_cast<unsigned int>(value), base) {}
+    String(double value, int decimals = 2) {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        text = buffer;
+    }
+
+    size_t length() const { return text.size(); }
+    bool isEmpty() const { return text.empty(); }
+    const char *c_str() const { return text.c_str(); }
+    bool reserve(size_t size) {
+        text.reserve(size);
+        return true;
+    }
+    bool concat(const String &other) {
+        text += other.text;
+        return true;
+    }
+    bool concat(const char *other) {
+        text += other;
+        return true;
+    }
+    bool concat(const char *other, size_t length) {
+        text.append(other, length);
+        return true;
+    }
+    bool concat(char c) {
+        text += c;
+        return true;
+    }
+    template <typename T>
+    String &operator+=(const T &value) {
+        concat(String(value));
+        return *this;
+    }
+    bool operator==(const String &other) const { return text == other.text; }
+    bool operator==(const char *other) const { return text == other; }
+    bool operator!=(const String &other) const { return text != other.text; }
+    bool operator!=(const char *other) const { return text != other; }
+    char operator[](size_t index) const { return text[index]; }
+    char &operator[](size_t index) { return text[index]; }
+    int indexOf(char c, int from = 0) const { return found(text.find(c, from)); }
+    int indexOf(const String &other, int from = 0) const { return found(text.find(other.text, from)); }
+    int lastIndexOf(char c) const { return found(text.rfind(c)); }
+    String substring(int from) const { return String(text.substr(from).c_str()); }
+    String substring(int from, int to) const { return String(text.substr(from, to - from).c_str()); }
+    bool startsWith(const String &prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+    bool equals(const String &other) const { return text == other.text; }
+    long toInt() const { return atol(text.c_str()); }
+    void remove(int from) { text.erase(from); }
+    void remove(int from, int count) { text.erase(from, count); }
+    void trim() {}
+    void toUpperCase() {
+        for (char &c : text) {
+            c = static_cast<char>(toupper(c));
+        }
+    }
+
+private:
+    std::string text;
+
+    template <typename T>
+    static std::string format(const char *pattern, T value) {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), pattern, value);
+        return buffer;
+    }
+
+    static int found(size_t position) { return position == std::string::npos ? -1 : static_cast<int>(position); }
+};
+
+inline String operator+(const String &left, const String &right) {
+    String result(left);
+    result.concat(right);
+    return result;
+}
+inline String operator+(const String &left, const char *right) { return left + String(right); }
+inline String operator+(const char *left, const String &right) { return String(left) + right; }
+inline String operator+(const String &left, char right) { return left + String(right); }
+inline String operator+(const String &left, int right) { return left + String(right); }
+inline String operator+(const String &left, unsigned long right) { return left + String(right); }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t length) {
+        size_t written = 0;
+        while (length-- > 0) {
+            written += write(*data++);
+        }
+        return written;
+    }
+    size_t write(const char *text) { return write(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+    size_t write(const char *data, size_t length) { return write(reinterpret_cast<const uint8_t *>(data), length); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const String &value) { return write(value.c_str()); }
+    size_t print(const char *value) { return write(value); }
+    size_t print(char value) { return write(static_cast<uint8_t>(value)); }
+    size_t print(int value, int base = DEC) { return print(String(value, base)); }
+    size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+    size_t print(long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(unsigned char value, int base = DEC) { return print(String(value, base)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+    template <typename T>
+    size_t println(const T &value) {
+        return print(value) + println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format) {
+        return print(value, format) + println();
+    }
+    size_t println() { return write("\r\n"); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+    size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t count = 0;
+        int c;
+        while (count < length && (c = read()) >= 0) {
+            buffer[count++] = static_cast<uint8_t>(c);
+        }
+        return count;
+    }
+    size_t readBytes(char *buffer, size_t length) { return readBytes(reinterpret_cast<uint8_t *>(buffer), length); }
+    void setTimeout(unsigned long) {}
+};
+
+#define SERIAL_8N1 0x06
+
+class HardwareSerial : public Stream {
+public:
+    virtual void begin(unsigned long baud) { rate = baud; }
+    void begin(unsigned long baud, int, int = -1, int = -1) { begin(baud); }
+    virtual void end() {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t) override { return 1; }
+    using Print::write;
+    int availableForWrite() override { return 63; }
+    void updateBaudRate(unsigned long baud) { rate = baud; }
+    unsigned long baudRate() const { return rate; }
+    operator bool() const { return true; }
+
+protected:
+    unsigned long rate = 115200;
+};
+
+inline HardwareSerial Serial, Serial1, Serial2, Serial3;
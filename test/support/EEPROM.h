@@ -0,0 +1,18 @@
+//
+// EEPROM.h
+// Description: Host stand-in for the Arduino EEPROM library, for the native test environment.
+//
+#pragma once
+#include <stdint.h>
+
+class EEPROMClass {
+public:
+    uint8_t read(int address) const { return memory[address]; }
+    void write(int address, uint8_t value) { memory[address] = value; }
+    void update(int address, uint8_t value) { memory[address] = value; }
+
+private:
+    uint8_t memory[4096] = {};
+};
+
+inline EEPROMClass EEPROM;
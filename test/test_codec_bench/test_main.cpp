@@ -0,0 +1,207 @@
+//
+// test_main.cpp
+// Description: Host benchmark of the schema-generated link codecs against hand-written put/get code.
+//
+// Run with `pio test -e native -f test_codec_bench -v` to see the timings.  The hand-written
+// functions below are the serializer and parser the generated ones replaced; both must
+// produce the same bytes, so only their speed is compared.
+//
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "link/LinkSchema.h"
+
+using namespace ActuatorsController;
+
+namespace {
+
+// A full STATUS frame: every entry is a keyframe carrying all of its fields.
+const uint8_t ENTRY_COUNT = 10;
+static_assert(StatusHeaderMessage::WIRE_SIZE + ENTRY_COUNT * StatusEntryMessage::MAX_WIRE_SIZE <= LINK_MAX_PAYLOAD_SIZE,
+              "the benchmark frame must fit one STATUS frame");
+const long ITERATIONS = 200000;
+
+// Defeats dead-code elimination of the benchmarked loops.
+volatile uint32_t sink;
+
+StatusEntryMessage entryFor(uint8_t index) {
+    StatusEntryMessage entry;
+    entry.index = index;
+    entry.present = StatusEntryMessage::ALL_FIELDS;
+    entry.flags = index & 1 ? ACTUATOR_FLAG_ACTIVE : 0;
+    entry.mode = index % 3;
+    entry.position = static_cast<uint16_t>(1000U * index + 17);
+    entry.maxDuration = 30000;
+    return entry;
+}
+
+void encodeGenerated(LinkFrameWriter &frame, uint32_t timestamp) {
+    StatusHeaderMessage header;
+    header.timestamp = timestamp;
+    header.flags = STATUS_FLAG_FORCE_MODE;
+    header.count = ENTRY_COUNT;
+    encodeMessage(frame, header);
+    for (uint8_t index = 0; index < ENTRY_COUNT; index++) {
+        encodeMessage(frame, entryFor(index));
+    }
+}
+
+void encodeHandWritten(LinkFrameWriter &frame, uint32_t timestamp) {
+    frame.putU32(timestamp);
+    frame.putU8(STATUS_FLAG_FORCE_MODE);
+    frame.putU8(ENTRY_COUNT);
+    for (uint8_t index = 0; index < ENTRY_COUNT; index++) {
+        StatusEntryMessage entry = entryFor(index);
+        frame.putU8(entry.index);
+        frame.putU8(entry.present);
+        frame.putU8(entry.flags);
+        frame.putU8(entry.mode);
+        frame.putU16(entry.position);
+        frame.putU16(entry.maxDuration);
+    }
+}
+
+// Both decoders sum what they read so the work cannot be skipped.
+uint32_t decodeGenerated(const uint8_t *payload, size_t length) {
+    LinkPayloadReader reader(payload, length);
+    StatusHeaderMessage header;
+    if (!decodeMessage(reader, header)) {
+        return 0;
+    }
+    uint32_t sum = header.timestamp + header.flags;
+    for (uint8_t entryNumber = 0; entryNumber < header.count; entryNumber++) {
+        StatusEntryMessage entry = StatusEntryMessage();
+        decodeMessage(reader, entry);
+        sum += entry.index + entry.flags + entry.mode + entry.position + entry.maxDuration;
+    }
+    return reader.isValid() ? sum : 0;
+}
+
+uint32_t decodeHandWritten(const uint8_t *payload, size_t length) {
+    LinkPayloadReader reader(payload, length);
+    uint32_t sum = reader.getU32();
+    sum += reader.getU8();
+    uint8_t count = reader.getU8();
+    for (uint8_t entryNumber = 0; entryNumber < count; entryNumber++) {
+        sum += reader.getU8();
+        reader.getU8();
+        sum += reader.getU8();
+        sum += reader.getU8();
+        sum += reader.getU16();
+        sum += reader.getU16();
+    }
+    return reader.isValid() ? sum : 0;
+}
+
+// Encodes a frame and returns its payload, which starts after the header of the COBS-decoded
+// bytes.
+size_t payloadOf(void (*encoder)(LinkFrameWriter &, uint32_t), uint8_t *payload) {
+    LinkFrameWriter frame(FrameType::STATUS);
+    encoder(frame, 123456UL);
+    uint8_t wire[LINK_MAX_ENCODED_SIZE];
+    size_t length = frame.encode(1, wire, sizeof(wire));
+    LinkFrameDecoder decoder;
+    bool complete = false;
+    decoder.feed(wire, length, complete);
+    if (!complete) {
+        return 0;
+    }
+    memcpy(payload, decoder.getFrame().payload, decoder.getFrame().payloadLength);
+    return decoder.getFrame().payloadLength;
+}
+
+template <typename Body>
+double nanosPerCall(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ITERATIONS; i++) {
+        body(static_cast<uint32_t>(i));
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+void report(const char *what, double generated, double handWritten) {
+    char line[120];
+    snprintf(line, sizeof(line), "%s: generated %.1f ns, hand-written %.1f ns per frame (%.2fx)", what, generated,
+             handWritten, generated / handWritten);
+    TEST_MESSAGE(line);
+}
+
+} // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_generated_status_encoding_matches_hand_written(void) {
+    uint8_t generated[LINK_MAX_PAYLOAD_SIZE];
+    uint8_t handWritten[LINK_MAX_PAYLOAD_SIZE];
+    size_t generatedLength = payloadOf(encodeGenerated, generated);
+    size_t handWrittenLength = payloadOf(encodeHandWritten, handWritten);
+    TEST_ASSERT_EQUAL(StatusHeaderMessage::WIRE_SIZE + ENTRY_COUNT * StatusEntryMessage::MAX_WIRE_SIZE,
+                      generatedLength);
+    TEST_ASSERT_EQUAL(generatedLength, handWrittenLength);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(handWritten, generated, generatedLength);
+    TEST_ASSERT_EQUAL(decodeHandWritten(generated, generatedLength), decodeGenerated(generated, generatedLength));
+}
+
+void test_generated_small_messages_match_hand_written(void) {
+    LinkFrameWriter generated(FrameType::ACK);
+    AckMessage ack;
+    ack.sequence = 0xBEEF;
+    ack.status = 2;
+    encodeMessage(generated, ack);
+    CommandMessage command;
+    command.opcode = 3;
+    command.actuator = 4;
+    encodeMessage(generated, command);
+
+    LinkFrameWriter handWritten(FrameType::ACK);
+    handWritten.putU16(0xBEEF);
+    handWritten.putU8(2);
+    handWritten.putU8(3);
+    handWritten.putU8(4);
+
+    uint8_t generatedWire[LINK_MAX_ENCODED_SIZE];
+    uint8_t handWrittenWire[LINK_MAX_ENCODED_SIZE];
+    size_t length = generated.encode(9, generatedWire, sizeof(generatedWire));
+    TEST_ASSERT_EQUAL(length, handWritten.encode(9, handWrittenWire, sizeof(handWrittenWire)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(handWrittenWire, generatedWire, length);
+}
+
+void test_benchmark_status_encode(void) {
+    double generated = nanosPerCall([](uint32_t i) {
+        LinkFrameWriter frame(FrameType::STATUS);
+        encodeGenerated(frame, i);
+        sink = sink + frame.hasOverflowed();
+    });
+    double handWritten = nanosPerCall([](uint32_t i) {
+        LinkFrameWriter frame(FrameType::STATUS);
+        encodeHandWritten(frame, i);
+        sink = sink + frame.hasOverflowed();
+    });
+    report("STATUS encode", generated, handWritten);
+}
+
+void test_benchmark_status_decode(void) {
+    static uint8_t payload[LINK_MAX_PAYLOAD_SIZE];
+    static size_t length = payloadOf(encodeGenerated, payload);
+    TEST_ASSERT_TRUE(length > 0);
+    double generated = nanosPerCall([](uint32_t i) {
+        payload[0] = static_cast<uint8_t>(i);
+        sink = sink + decodeGenerated(payload, length);
+    });
+    double handWritten = nanosPerCall([](uint32_t i) {
+        payload[0] = static_cast<uint8_t>(i);
+        sink = sink + decodeHandWritten(payload, length);
+    });
+    report("STATUS decode", generated, handWritten);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_generated_status_encoding_matches_hand_written);
+    RUN_TEST(test_generated_small_messages_match_hand_written);
+    RUN_TEST(test_benchmark_status_encode);
+    RUN_TEST(test_benchmark_status_decode);
+    return UNITY_END();
+}
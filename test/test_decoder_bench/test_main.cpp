@@ -0,0 +1,154 @@
+//
+// test_main.cpp
+// Description: Host benchmark of LinkFrameDecoder fed byte by byte and in blocks.
+//
+// Run with `pio test -e native -f test_decoder_bench -v` to see the rates.  The stream is the
+// traffic of a busy link: full STATUS frames with ACKs and heartbeats in between.  The block
+// path is fed READ_CHUNK bytes at a time, the way the ESP32 reads its UART, and must decode
+// exactly the frames the byte path does.
+//
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "link/LinkSchema.h"
+
+using namespace ActuatorsController;
+
+namespace {
+
+const size_t READ_CHUNK = 64;
+const int FRAME_GROUPS = 200;
+const int PASSES = 200;
+
+// Defeats dead-code elimination of the benchmarked loops.
+volatile uint32_t sink;
+
+void appendFrame(std::vector<uint8_t> &stream, LinkFrameWriter &frame, uint16_t sequence) {
+    uint8_t wire[LINK_MAX_ENCODED_SIZE];
+    size_t length = frame.encode(sequence, wire, sizeof(wire));
+    stream.insert(stream.end(), wire, wire + length);
+}
+
+std::vector<uint8_t> busyLinkStream(int &frameCount) {
+    std::vector<uint8_t> stream;
+    uint16_t sequence = 0;
+    for (int group = 0; group < FRAME_GROUPS; group++) {
+        LinkFrameWriter status(FrameType::STATUS);
+        StatusHeaderMessage header = StatusHeaderMessage();
+        header.timestamp = 1000UL * group;
+        header.count = 10;
+        encodeMessage(status, header);
+        for (uint8_t index = 0; index < header.count; index++) {
+            StatusEntryMessage entry = StatusEntryMessage();
+            entry.index = index;
+            entry.present = StatusEntryMessage::ALL_FIELDS;
+            entry.position = static_cast<uint16_t>(group * 10 + index);
+            entry.maxDuration = 30000;
+            encodeMessage(status, entry);
+        }
+        appendFrame(stream, status, sequence++);
+
+        LinkFrameWriter ack(FrameType::ACK);
+        AckMessage message;
+        message.sequence = static_cast<uint16_t>(group);
+        message.status = 0;
+        encodeMessage(ack, message);
+        appendFrame(stream, ack, sequence++);
+
+        LinkFrameWriter heartbeat(FrameType::HEARTBEAT);
+        HeartbeatMessage beat = HeartbeatMessage();
+        beat.timestamp = 1000UL * group;
+        encodeMessage(heartbeat, beat);
+        appendFrame(stream, heartbeat, sequence++);
+    }
+    frameCount = 3 * FRAME_GROUPS;
+    return stream;
+}
+
+// Both decoders sum the sequence numbers of the frames they complete.
+uint32_t decodeBytewise(LinkFrameDecoder &decoder, const std::vector<uint8_t> &stream) {
+    uint32_t sum = 0;
+    for (uint8_t byte : stream) {
+        if (decoder.feed(byte)) {
+            sum += decoder.getFrame().sequence + 1;
+        }
+    }
+    return sum;
+}
+
+uint32_t decodeBlocks(LinkFrameDecoder &decoder, const std::vector<uint8_t> &stream) {
+    uint32_t sum = 0;
+    for (size_t start = 0; start < stream.size(); start += READ_CHUNK) {
+        size_t count = stream.size() - start < READ_CHUNK ? stream.size() - start : READ_CHUNK;
+        const uint8_t *chunk = stream.data() + start;
+        size_t used = 0;
+        while (used < count) {
+            bool complete;
+            used += decoder.feed(chunk + used, count - used, complete);
+            if (complete) {
+                sum += decoder.getFrame().sequence + 1;
+            }
+        }
+    }
+    return sum;
+}
+
+// Seconds per pass over the stream.
+template <typename Body>
+double secondsPerPass(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        body();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / PASSES;
+}
+
+void report(const char *what, double seconds, int frames, size_t bytes) {
+    char line[120];
+    snprintf(line, sizeof(line), "%s: %.0f frames/s, %.1f MB/s", what, frames / seconds, bytes / seconds / 1e6);
+    TEST_MESSAGE(line);
+}
+
+} // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_block_feed_decodes_what_byte_feed_does(void) {
+    int frames;
+    std::vector<uint8_t> stream = busyLinkStream(frames);
+    LinkFrameDecoder bytewise;
+    LinkFrameDecoder blocks;
+    uint32_t expected = decodeBytewise(bytewise, stream);
+    TEST_ASSERT_EQUAL(expected, decodeBlocks(blocks, stream));
+    TEST_ASSERT_EQUAL(frames, bytewise.getFrameCount());
+    TEST_ASSERT_EQUAL(frames, blocks.getFrameCount());
+    TEST_ASSERT_EQUAL(0, blocks.getCrcErrorCount() + blocks.getFormatErrorCount());
+}
+
+void test_benchmark_decoder_feed(void) {
+    static int frames;
+    static std::vector<uint8_t> stream = busyLinkStream(frames);
+    double bytewise = secondsPerPass([] {
+        LinkFrameDecoder decoder;
+        sink = sink + decodeBytewise(decoder, stream);
+    });
+    double blocks = secondsPerPass([] {
+        LinkFrameDecoder decoder;
+        sink = sink + decodeBlocks(decoder, stream);
+    });
+    report("byte feed", bytewise, frames, stream.size());
+    report("block feed", blocks, frames, stream.size());
+    char line[80];
+    snprintf(line, sizeof(line), "block feed is %.2fx the byte feed", bytewise / blocks);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_feed_decodes_what_byte_feed_does);
+    RUN_TEST(test_benchmark_decoder_feed);
+    return UNITY_END();
+}
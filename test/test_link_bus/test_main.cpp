@@ -0,0 +1,398 @@
+//
+// test_main.cpp
+// Description: Host simulation of the RS-485 bus: the ESP32's LinkBus polling several Megas.
+//
+// Every board gets a port on one shared wire.  Bytes leave a port's transmit buffer one
+// character time apart at the bus rate, reach every port whose driver is off, and are lost
+// if their sender's driver is off or a second driver is on while they are on the wire.
+// Time only moves in the simulation: the boards' loops run once a millisecond, and a board
+// waiting on its UART (a full buffer or flush()) holds everyone else up, as it would hold
+// up its own loop.
+//
+#include <unity.h>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "esp32/LinkBus.h"
+#include "mega/MegaLinkReceiver.h"
+
+using namespace ActuatorsController;
+
+namespace {
+
+const unsigned long STEP_MICROS = 10;
+const unsigned long LOOP_MICROS = 1000;
+// One character at the bus rate, to the nearest microsecond.
+const unsigned long CHAR_MICROS = (10000000UL + LINK_BAUD_RATES[0] / 2) / LINK_BAUD_RATES[0];
+const int ESP_DE_PIN = 20;
+const int MEGA_DE_PIN = 30;
+const uint8_t NODE_COUNT = 3;
+
+void setClock(unsigned long now) {
+    hostMicros = now;
+    hostMillis = now / 1000;
+}
+
+class BusPort;
+
+// The twisted pair every port is attached to.
+class BusWire {
+public:
+    std::vector<BusPort *> ports;
+    // Bytes sent while another driver was on, and bytes sent with the sender's driver off.
+    unsigned collisions = 0;
+    unsigned undriven = 0;
+
+    // Moves the simulation on by one step.
+    void step();
+
+    unsigned driversOn() const;
+};
+
+// A UART behind an RS-485 transceiver whose DE and /RE pins are tied to dePin.
+class BusPort : public HardwareSerial {
+public:
+    BusPort(BusWire &wire, int dePin, size_t txCapacity, size_t rxCapacity) :
+        wire(wire), dePin(dePin), txCapacity(txCapacity), rxCapacity(rxCapacity) {
+        wire.ports.push_back(this);
+    }
+
+    int available() override { return static_cast<int>(rx.size()); }
+    int read() override {
+        if (rx.empty()) {
+            return -1;
+        }
+        uint8_t c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    // Blocks like the real UART while the buffer is full.
+    size_t write(const uint8_t *data, size_t length) override {
+        for (size_t i = 0; i < length; i++) {
+            while (tx.size() >= txCapacity) {
+                wire.step();
+            }
+            if (tx.empty()) {
+                byteStart = hostMicros;
+                byteLost = false;
+            }
+            tx.push_back(data[i]);
+        }
+        return length;
+    }
+    using Print::write;
+    int availableForWrite() override { return static_cast<int>(txCapacity - tx.size()); }
+    void flush() override {
+        while (!tx.empty()) {
+            wire.step();
+        }
+    }
+
+    bool driving() const { return digitalRead(dePin) == HIGH; }
+
+    // Called by the wire every step: finishes the bytes whose time is up.
+    void shift() {
+        if (tx.empty()) {
+            return;
+        }
+        if (!driving()) {
+            byteLost = true;
+        } else if (wire.driversOn() > 1) {
+            byteCollided = true;
+        }
+        while (!tx.empty() && hostMicros - byteStart >= CHAR_MICROS) {
+            uint8_t c = tx.front();
+            tx.pop_front();
+            if (byteLost) {
+                wire.undriven++;
+            } else if (byteCollided) {
+                wire.collisions++;
+            } else {
+                for (BusPort *port : wire.ports) {
+                    if (port != this && !port->driving()) {
+                        port->receive(c);
+                    }
+                }
+            }
+            byteStart += CHAR_MICROS;
+            byteLost = !driving();
+            byteCollided = false;
+        }
+    }
+
+    // Bytes dropped because the receive buffer was full.
+    unsigned rxOverflows = 0;
+
+private:
+    BusWire &wire;
+    int dePin;
+    size_t txCapacity;
+    size_t rxCapacity;
+    std::deque<uint8_t> tx;
+    std::deque<uint8_t> rx;
+    unsigned long byteStart = 0;
+    bool byteLost = false;
+    bool byteCollided = false;
+
+    void receive(uint8_t c) {
+        if (rx.size() >= rxCapacity) {
+            rxOverflows++;
+            return;
+        }
+        rx.push_back(c);
+    }
+};
+
+void BusWire::step() {
+    setClock(hostMicros + STEP_MICROS);
+    for (BusPort *port : ports) {
+        port->shift();
+    }
+}
+
+unsigned BusWire::driversOn() const {
+    unsigned count = 0;
+    for (const BusPort *port : ports) {
+        count += port->driving();
+    }
+    return count;
+}
+
+// A STATUS frame carrying every field of ten actuators, close to the largest frame there is.
+void sendFullStatus(MegaLink &link) {
+    LinkFrameWriter frame(FrameType::STATUS);
+    StatusHeaderMessage header = StatusHeaderMessage();
+    header.timestamp = millis();
+    header.count = 10;
+    encodeMessage(frame, header);
+    for (uint8_t index = 0; index < header.count; index++) {
+        StatusEntryMessage entry = StatusEntryMessage();
+        entry.index = index;
+        entry.present = StatusEntryMessage::ALL_FIELDS;
+        entry.position = 100U * index;
+        entry.maxDuration = 30000;
+        encodeMessage(frame, entry);
+    }
+    link.send(frame, TxPriority::PERIODIC);
+}
+
+// One Mega on the bus.  A dead Mega never runs its loop; a busy one always has STATUS
+// frames queued, and a stalling one also stops for stallMillis right after being granted
+// every third turn, as if its control loop had blocked.
+struct Mega {
+    BusPort port;
+    MegaTxChannel<128, 256, 256, 0> tx;
+    MegaLink link;
+    MegaCommandQueue queue;
+    MegaLinkReceiver receiver;
+    MegaLinkBus bus;
+    bool dead = false;
+    bool busy = false;
+    unsigned long stallMillis = 0;
+    unsigned long stallUntil = 0;
+    uint16_t turnsSeen = 0;
+    uint16_t commandCount = 0;
+
+    Mega(BusWire &wire, uint8_t address) :
+        port(wire, MEGA_DE_PIN + address, 63, 63), tx(port), link(tx, address), receiver(port, queue, link, address),
+        bus(port, tx, link, MEGA_DE_PIN + address) {
+        bus.begin();
+        receiver.attachBus(bus);
+    }
+
+    void loop() {
+        if (dead || static_cast<long>(hostMicros - stallUntil) < 0) {
+            return;
+        }
+        while (busy && tx.getQueuedBytes(TxPriority::PERIODIC) < 128) {
+            sendFullStatus(link);
+        }
+        receiver.poll();
+        bus.service();
+        MegaCommand command;
+        while (queue.pop(command)) {
+            commandCount++;
+        }
+        if (bus.getTurnCount() != turnsSeen) {
+            turnsSeen = bus.getTurnCount();
+            if (stallMillis > 0 && turnsSeen % 3 == 0) {
+                stallUntil = hostMicros + stallMillis * 1000UL;
+            }
+        }
+    }
+};
+
+// The ESP32 and NODE_COUNT Megas on one wire.
+struct Rig {
+    BusWire wire;
+    BusPort espPort;
+    LinkBus master;
+    std::vector<std::unique_ptr<LinkNode>> nodes;
+    std::vector<std::unique_ptr<Mega>> megas;
+    // Longest the ESP32's link step took.
+    unsigned long longestUpdate = 0;
+
+    Rig() : espPort(wire, ESP_DE_PIN, LinkBus::TX_FIFO_SIZE, 256), master(espPort, ESP_DE_PIN) {
+        for (uint8_t address = LINK_FIRST_NODE; address < LINK_FIRST_NODE + NODE_COUNT; address++) {
+            nodes.emplace_back(new LinkNode(address));
+            master.addNode(*nodes.back());
+            megas.emplace_back(new Mega(wire, address));
+        }
+        master.begin();
+    }
+
+    LinkNode &node(uint8_t position) { return *nodes[position]; }
+    Mega &mega(uint8_t position) { return *megas[position]; }
+
+    void run(unsigned long ms) {
+        unsigned long end = hostMicros + ms * 1000UL;
+        unsigned long nextLoop = hostMicros;
+        while (static_cast<long>(hostMicros - end) < 0) {
+            wire.step();
+            if (static_cast<long>(hostMicros - nextLoop) < 0) {
+                continue;
+            }
+            nextLoop += LOOP_MICROS;
+            unsigned long start = hostMicros;
+            master.update();
+            if (hostMicros - start > longestUpdate) {
+                longestUpdate = hostMicros - start;
+            }
+            for (auto &mega : megas) {
+                mega->loop();
+            }
+        }
+    }
+
+    // Every node the ESP32 and its Mega both consider up.
+    unsigned nodesUp() {
+        unsigned count = 0;
+        for (uint8_t i = 0; i < NODE_COUNT; i++) {
+            count += node(i).processor.isLinkUp() && mega(i).receiver.getHeartbeat().isUp(millis());
+        }
+        return count;
+    }
+};
+
+// What the ESP32 may spend in one link step: the tail of a poll it waits out, and a little
+// for the simulation's step size.
+const unsigned long UPDATE_BUDGET_MICROS = (LinkBus::RELEASE_TAIL_BYTES + 1) * CHAR_MICROS + 2 * STEP_MICROS;
+
+} // namespace
+
+namespace ActuatorsController {
+HardwareSerial consolePort;
+MegaTxChannel<0, 0, 0, 256> consoleTx(consolePort);
+MegaTxPrint debugSerial(consoleTx, TxPriority::DEBUG);
+MegaTrace megaTrace(consoleTx);
+} // namespace ActuatorsController
+
+void setUp(void) {
+    setClock(1000000);
+    for (int &pin : hostPins) {
+        pin = LOW;
+    }
+}
+
+void tearDown(void) {}
+
+void test_every_node_answers_its_polls(void) {
+    Rig rig;
+    rig.run(3000);
+    TEST_ASSERT_EQUAL(NODE_COUNT, rig.nodesUp());
+    for (uint8_t i = 0; i < NODE_COUNT; i++) {
+        TEST_ASSERT_EQUAL(0, rig.node(i).timeoutCount);
+        TEST_ASSERT_TRUE(rig.node(i).pollCount > 100);
+        TEST_ASSERT_EQUAL(0, rig.mega(i).bus.getCutShortCount());
+        TEST_ASSERT_EQUAL(0, rig.mega(i).port.rxOverflows);
+    }
+    TEST_ASSERT_EQUAL(0, rig.wire.collisions);
+    TEST_ASSERT_EQUAL(0, rig.wire.undriven);
+    TEST_ASSERT_EQUAL(0, rig.master.getDecoder().getCrcErrorCount());
+    TEST_ASSERT_EQUAL(0, rig.master.getStrayFrameCount());
+    TEST_ASSERT_TRUE(rig.longestUpdate <= UPDATE_BUDGET_MICROS);
+}
+
+// A Mega that never answers costs its poll timeout every round and nothing more.
+void test_dead_node_times_out_without_holding_up_the_others(void) {
+    Rig rig;
+    rig.mega(1).dead = true;
+    rig.run(3000);
+    TEST_ASSERT_FALSE(rig.node(1).processor.isLinkUp());
+    TEST_ASSERT_TRUE(rig.node(1).timeoutCount > 10);
+    TEST_ASSERT_TRUE(rig.node(0).processor.isLinkUp());
+    TEST_ASSERT_TRUE(rig.node(2).processor.isLinkUp());
+    TEST_ASSERT_EQUAL(0, rig.node(0).timeoutCount);
+    TEST_ASSERT_EQUAL(0, rig.node(2).timeoutCount);
+    TEST_ASSERT_TRUE(rig.master.getLastRoundMillis() < LinkBus::POLL_TIMEOUT_MS + 2 * LinkBus::MAX_POLL_SEND_MS + 10);
+    TEST_ASSERT_EQUAL(0, rig.wire.collisions);
+    TEST_ASSERT_EQUAL(0, rig.wire.undriven);
+
+    // and it is back within a round or two once it answers again.
+    rig.mega(1).dead = false;
+    rig.run(1000);
+    TEST_ASSERT_EQUAL(NODE_COUNT, rig.nodesUp());
+    TEST_ASSERT_EQUAL(0, rig.wire.collisions);
+}
+
+// A Mega whose loop stalls in its turn cuts the turn short: the frame it was sending is
+// dropped, END still reaches the ESP32 in time, and nobody else's turn is disturbed.
+void test_overrunning_node_is_cut_short(void) {
+    Rig rig;
+    for (uint8_t i = 0; i < NODE_COUNT; i++) {
+        rig.mega(i).busy = true;
+    }
+    rig.mega(1).stallMillis = 20;
+    rig.run(3000);
+    TEST_ASSERT_EQUAL(NODE_COUNT, rig.nodesUp());
+    TEST_ASSERT_TRUE(rig.mega(1).bus.getCutShortCount() > 2);
+    TEST_ASSERT_EQUAL(0, rig.mega(0).bus.getCutShortCount());
+    TEST_ASSERT_EQUAL(0, rig.mega(2).bus.getCutShortCount());
+    for (uint8_t i = 0; i < NODE_COUNT; i++) {
+        TEST_ASSERT_EQUAL(0, rig.node(i).timeoutCount);
+    }
+    // the cut frames, and nothing else, are dropped by the ESP32.
+    const LinkFrameDecoder &decoder = rig.master.getDecoder();
+    uint16_t dropped = decoder.getCrcErrorCount() + decoder.getFormatErrorCount();
+    TEST_ASSERT_TRUE(dropped > 0);
+    TEST_ASSERT_TRUE(dropped <= rig.mega(1).bus.getCutShortCount());
+    TEST_ASSERT_EQUAL(0, rig.wire.collisions);
+    TEST_ASSERT_EQUAL(0, rig.wire.undriven);
+    TEST_ASSERT_TRUE(rig.longestUpdate <= UPDATE_BUDGET_MICROS);
+}
+
+// Commands queued faster than one poll carries go out over several polls, and the ESP32
+// never waits on the UART for more than the tail of a poll.
+void test_busy_outbox_is_spread_over_polls(void) {
+    Rig rig;
+    rig.run(1000);
+    const uint16_t COMMANDS = 30;
+    TEST_ASSERT_TRUE(COMMANDS * (LINK_HEADER_SIZE + LINK_CRC_SIZE + 4) > 2 * LinkBus::OUTBOX_BYTES_PER_POLL);
+    uint16_t received = rig.mega(0).commandCount;
+    uint32_t polls = rig.node(0).pollCount;
+    uint16_t sequence = 0;
+    for (uint16_t i = 0; i < COMMANDS; i++) {
+        sequence = rig.node(0).executor.send(Opcode::SNAPSHOT, ALL_ACTUATORS);
+        TEST_ASSERT_TRUE(sequence != 0);
+    }
+    rig.run(1000);
+    TEST_ASSERT_EQUAL(received + COMMANDS, rig.mega(0).commandCount);
+    TEST_ASSERT_EQUAL(ActuatorCommandExecutor::CommandState::ACKED, rig.node(0).executor.getState(sequence));
+    TEST_ASSERT_EQUAL(0, rig.node(0).executor.getTimeoutCount());
+    TEST_ASSERT_EQUAL(0, rig.node(0).outbox.getDroppedCount());
+    TEST_ASSERT_TRUE(rig.node(0).pollCount > polls + 2);
+    TEST_ASSERT_EQUAL(0, rig.mega(0).port.rxOverflows);
+    TEST_ASSERT_EQUAL(0, rig.wire.collisions);
+    TEST_ASSERT_EQUAL(0, rig.wire.undriven);
+    TEST_ASSERT_TRUE(rig.longestUpdate <= UPDATE_BUDGET_MICROS);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_node_answers_its_polls);
+    RUN_TEST(test_dead_node_times_out_without_holding_up_the_others);
+    RUN_TEST(test_overrunning_node_is_cut_short);
+    RUN_TEST(test_busy_outbox_is_spread_over_polls);
+    return UNITY_END();
+}
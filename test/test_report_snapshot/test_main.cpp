@@ -0,0 +1,151 @@
+//
+// test_main.cpp
+// Description: Host stress test of ReportSnapshot with a writer thread racing reader threads.
+//
+// The writer publishes reports whose every field is derived from the publish number, so a
+// copy that mixes two reports shows up as fields that disagree.  Readers check each report
+// they get for that, and that the publish numbers they see never go backwards.
+//
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "esp32/ReportSnapshot.h"
+
+using namespace ActuatorsController;
+
+namespace {
+
+const uint32_t PUBLISHES = 200000;
+const int READERS = 3;
+
+void fillReport(StatusReportData &report, uint32_t number) {
+    report.wallTime = number * 1000ULL;
+    report.timestamp = number;
+    report.localTimestamp = ~number;
+    report.generation = static_cast<uint16_t>(number);
+    report.node = static_cast<uint8_t>(number);
+    report.actuatorCount = StatusReportData::MAX_ACTUATORS;
+    for (uint8_t i = 0; i < StatusReportData::MAX_ACTUATORS; i++) {
+        ActuatorData &actuator = report.actuators[i];
+        actuator.wallTime = number * 1000ULL + i;
+        actuator.timestamp = number;
+        actuator.position = number + i;
+        actuator.maxDuration = number ^ 0xA5A5A5A5U;
+        actuator.receivedAt = ~number;
+        actuator.generation = static_cast<uint16_t>(number + i);
+        actuator.index = i;
+    }
+}
+
+// True if every field agrees with the publish number the report was written for.
+bool isWhole(const StatusReportData &report, uint32_t number) {
+    StatusReportData expected;
+    memset(&expected, 0, sizeof(expected));
+    fillReport(expected, number);
+    if (report.wallTime != expected.wallTime || report.timestamp != expected.timestamp ||
+        report.localTimestamp != expected.localTimestamp || report.generation != expected.generation ||
+        report.node != expected.node || report.actuatorCount != expected.actuatorCount) {
+        return false;
+    }
+    for (uint8_t i = 0; i < StatusReportData::MAX_ACTUATORS; i++) {
+        const ActuatorData &actuator = report.actuators[i];
+        const ActuatorData &wanted = expected.actuators[i];
+        if (actuator.wallTime != wanted.wallTime || actuator.timestamp != wanted.timestamp ||
+            actuator.position != wanted.position || actuator.maxDuration != wanted.maxDuration ||
+            actuator.receivedAt != wanted.receivedAt || actuator.generation != wanted.generation ||
+            actuator.index != wanted.index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ReaderResult {
+    uint32_t reads = 0;
+    uint32_t distinct = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+};
+
+} // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_read_before_publish_returns_nothing(void) {
+    ReportSnapshot snapshot;
+    StatusReportData report;
+    memset(&report, 0x5A, sizeof(report));
+    TEST_ASSERT_EQUAL(0, snapshot.read(report));
+    TEST_ASSERT_EQUAL_HEX8(0x5A, report.node);
+
+    StatusReportData published;
+    memset(&published, 0, sizeof(published));
+    fillReport(published, 1);
+    snapshot.publish(published);
+    TEST_ASSERT_EQUAL(1, snapshot.read(report));
+    TEST_ASSERT_TRUE(isWhole(report, 1));
+}
+
+void test_readers_never_see_a_torn_report(void) {
+    static ReportSnapshot snapshot;
+    std::atomic<bool> done(false);
+    std::vector<ReaderResult> results(READERS);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS; r++) {
+        readers.emplace_back([&done, &results, r] {
+            ReaderResult &result = results[r];
+            StatusReportData report;
+            uint32_t last = 0;
+            while (!done.load(std::memory_order_acquire)) {
+                uint32_t number = snapshot.read(report);
+                if (number == 0) {
+                    continue;
+                }
+                result.reads++;
+                if (!isWhole(report, number)) {
+                    result.torn++;
+                }
+                if (number < last) {
+                    result.backwards++;
+                } else if (number > last) {
+                    result.distinct++;
+                }
+                last = number;
+            }
+        });
+    }
+
+    StatusReportData report;
+    memset(&report, 0, sizeof(report));
+    for (uint32_t number = 1; number <= PUBLISHES; number++) {
+        fillReport(report, number);
+        snapshot.publish(report);
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    TEST_ASSERT_EQUAL(PUBLISHES, snapshot.getPublishCount());
+    uint32_t reads = 0;
+    for (const ReaderResult &result : results) {
+        TEST_ASSERT_EQUAL(0, result.torn);
+        TEST_ASSERT_EQUAL(0, result.backwards);
+        TEST_ASSERT_TRUE(result.reads > 0);
+        reads += result.reads;
+    }
+    char line[120];
+    snprintf(line, sizeof(line), "%u reads by %d readers during %u publishes, %u retried", reads, READERS,
+             PUBLISHES, snapshot.getRetryCount());
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_read_before_publish_returns_nothing);
+    RUN_TEST(test_readers_never_see_a_torn_report);
+    return UNITY_END();
+}
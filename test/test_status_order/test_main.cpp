@@ -0,0 +1,216 @@
+//
+// test_main.cpp
+// Description: Host tests of the order in which the Mega's STATUS frames reach the wire.
+//
+// The reporter queues frames on the real MegaLink and MegaTxScheduler; the port holds back
+// every byte until the test opens it, so frames can be left waiting in the priority lanes
+// the way a busy UART leaves them.  What comes out is applied in order like the ESP32 does.
+//
+#include <unity.h>
+#include <vector>
+#include "mega/ActuatorReporter.h"
+
+using namespace ActuatorsController;
+
+namespace {
+
+// Collects what the scheduler writes; room is what availableForWrite() reports.
+class CapturePort : public HardwareSerial {
+public:
+    std::vector<uint8_t> sent;
+    int room = 0;
+
+    size_t write(uint8_t c) override {
+        sent.push_back(c);
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t length) override {
+        sent.insert(sent.end(), data, data + length);
+        room -= static_cast<int>(length);
+        return length;
+    }
+    using Print::write;
+    int availableForWrite() override { return room; }
+};
+
+// What the ESP32 holds for one actuator after applying the frames.
+struct Applied {
+    uint8_t mode = 0;
+    uint16_t position = 0;
+    unsigned frames = 0;
+};
+
+CapturePort linkPort;
+HardwareSerial consolePort;
+MegaTxChannel<128, 256, 128, 64> linkTx(linkPort);
+MegaTxChannel<0, 0, 0, 256> consoleTx(consolePort);
+std::vector<uint16_t> sequences;
+
+// Sends everything queued and applies each STATUS entry for actuator to the result.  The
+// sequence numbers of the frames sent are left in sequences.
+Applied drain(int actuator, Applied applied = Applied()) {
+    linkPort.sent.clear();
+    sequences.clear();
+    linkPort.room = 4096;
+    linkTx.service();
+    LinkFrameDecoder decoder;
+    for (uint8_t byte : linkPort.sent) {
+        if (!decoder.feed(byte)) {
+            continue;
+        }
+        const LinkFrame &frame = decoder.getFrame();
+        sequences.push_back(frame.sequence);
+        if (frame.type != FrameType::STATUS) {
+            continue;
+        }
+        LinkPayloadReader payload(frame.payload, frame.payloadLength);
+        StatusHeaderMessage header;
+        decodeMessage(payload, header);
+        for (uint8_t i = 0; i < header.count; i++) {
+            StatusEntryMessage entry;
+            decodeMessage(payload, entry);
+            if (entry.index != actuator) {
+                continue;
+            }
+            if (entry.present & (1U << StatusEntryMessage::Field::mode)) {
+                applied.mode = entry.mode;
+            }
+            if (entry.present & (1U << StatusEntryMessage::Field::position)) {
+                applied.position = entry.position;
+            }
+            applied.frames++;
+        }
+    }
+    linkPort.room = 0;
+    return applied;
+}
+
+// A freshly started Mega whose first report the ESP32 has already applied.
+struct Mega {
+    MegaLink link;
+    MegaRelayControl relays;
+    ActuatorReporter reporter;
+
+    Mega() : link(linkTx, LINK_FIRST_NODE), reporter(relays, link) {
+        reporter.sendStatusReport(0xFF);
+        drain(0);
+    }
+};
+
+} // namespace
+
+namespace ActuatorsController {
+MegaTxPrint debugSerial(consoleTx, TxPriority::DEBUG);
+MegaTrace megaTrace(consoleTx);
+} // namespace ActuatorsController
+
+void setUp(void) {
+    hostMillis = 1000;
+    linkPort.room = 0;
+}
+
+void tearDown(void) {}
+
+// An actuator starts, streams a position that is still queued when it stops: the stop must
+// be the last thing the ESP32 applies, with the position the actuator stopped at.
+void test_late_position_does_not_follow_stop(void) {
+    Mega mega;
+    mega.relays.activate(0);
+    TEST_ASSERT_TRUE(mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0)));
+    Applied applied = drain(0);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(LinkMode::EXTENDING), applied.mode);
+
+    hostAdvance(400);
+    uint16_t queuedBytes = 0;
+    TEST_ASSERT_TRUE(mega.reporter.sendPositionUpdate(0, queuedBytes));
+    TEST_ASSERT_TRUE(queuedBytes > 0);
+
+    hostAdvance(100);
+    uint16_t merged = linkTx.getMergedFrames();
+    mega.relays.pauseSingleActuator(0);
+    TEST_ASSERT_TRUE(mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0)));
+    applied = drain(0, applied);
+
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(LinkMode::IDLE), applied.mode);
+    TEST_ASSERT_EQUAL(500, applied.position);
+    TEST_ASSERT_EQUAL(mega.relays.relayStates[0].actuatorPosition, applied.position);
+    // only the stop went out; the queued position was dropped.
+    TEST_ASSERT_EQUAL(2, applied.frames);
+    TEST_ASSERT_EQUAL(merged + 1, linkTx.getMergedFrames());
+}
+
+// A position that has already gone out needs no dropping, and the stop still carries the
+// final position even though that field alone would not have changed since the update.
+void test_stop_carries_position_after_streaming(void) {
+    Mega mega;
+    mega.relays.activate(0);
+    mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0));
+    Applied applied = drain(0);
+
+    hostAdvance(300);
+    uint16_t queuedBytes = 0;
+    mega.reporter.sendPositionUpdate(0, queuedBytes);
+    applied = drain(0, applied);
+    TEST_ASSERT_EQUAL(300, applied.position);
+
+    mega.relays.pauseSingleActuator(0);
+    mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0));
+    applied = drain(0, applied);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(LinkMode::IDLE), applied.mode);
+    TEST_ASSERT_EQUAL(300, applied.position);
+    TEST_ASSERT_EQUAL(3, applied.frames);
+}
+
+// Position updates for an actuator the STATUS frame does not carry are left alone.
+void test_other_actuators_keep_their_positions(void) {
+    Mega mega;
+    mega.relays.activate(0);
+    mega.relays.activate(1);
+    mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0) | ActuatorReporter::maskFor(1));
+    drain(1);
+
+    hostAdvance(200);
+    uint16_t queuedBytes = 0;
+    mega.reporter.sendPositionUpdate(0, queuedBytes);
+    mega.reporter.sendPositionUpdate(1, queuedBytes);
+    mega.relays.pauseSingleActuator(0);
+    mega.reporter.sendStatusReport(ActuatorReporter::maskFor(0));
+    Applied applied = drain(1);
+    TEST_ASSERT_EQUAL(1, applied.frames);
+    TEST_ASSERT_EQUAL(200, applied.position);
+}
+
+// Frames are numbered in the order they go on the wire, whichever lane they waited in, and
+// one dropped from the queue uses up no number, so the ESP32 sees no gap.
+void test_frames_are_numbered_on_the_wire(void) {
+    Mega mega;
+    mega.relays.activate(1);
+    mega.reporter.sendStatusReport(ActuatorReporter::maskFor(1));
+    drain(1);
+    uint16_t first = mega.link.getNextSequence();
+
+    hostAdvance(200);
+    uint16_t queuedBytes = 0;
+    mega.reporter.sendPositionUpdate(1, queuedBytes);
+    // queued after the position update, sent before it.
+    mega.link.sendAck(7, CommandStatus::OK);
+    hostAdvance(100);
+    // replaces the first position update.
+    mega.reporter.sendPositionUpdate(1, queuedBytes);
+    Applied applied = drain(1);
+
+    TEST_ASSERT_EQUAL(300, applied.position);
+    TEST_ASSERT_EQUAL(2, sequences.size());
+    TEST_ASSERT_EQUAL(first, sequences[0]);
+    TEST_ASSERT_EQUAL(static_cast<uint16_t>(first + 1), sequences[1]);
+    TEST_ASSERT_EQUAL(static_cast<uint16_t>(first + 2), mega.link.getNextSequence());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_late_position_does_not_follow_stop);
+    RUN_TEST(test_stop_carries_position_after_streaming);
+    RUN_TEST(test_other_actuators_keep_their_positions);
+    RUN_TEST(test_frames_are_numbered_on_the_wire);
+    return UNITY_END();
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+#
+# trace_decode.py
+# Description: Turns the Mega's console output back into readable log lines.
+#
+# The Mega writes debug events as binary trace records (see include/mega/MegaTrace.h) mixed
+# with ordinary text lines.  The event texts are read from MegaTrace.h itself, so run this
+# from a checkout matching the firmware that produced the log.
+#
+#   python3 tools/trace_decode.py capture.bin
+#   python3 tools/trace_decode.py --port COM7          (needs pyserial)
+#
+import argparse
+import os
+import re
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+TRACE_HEADER = os.path.join(ROOT, "include", "mega", "MegaTrace.h")
+COMMANDS_HEADER = os.path.join(ROOT, "include", "link", "LinkCommands.h")
+
+FRAME_TYPE_TRACE = 0x06
+HEADER_SIZE = 5  # [version][type][node][sequence u16]
+PLACEHOLDER = re.compile(r"\{(u8|u16|u32|i8|i16|i32|x8|x16|x32|op)\}")
+SIZES = {"8": 1, "16": 2, "32": 4}
+
+
+def load_events(path):
+    """Event texts in TraceId order, from the MEGA_TRACE_EVENTS list."""
+    with open(path) as f:
+        source = f.read()
+    block = source[source.index("#define MEGA_TRACE_EVENTS"):]
+    block = block[:block.index("\n\n")]
+    return re.findall(r'X\(\s*\w+\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', block)
+
+
+def load_opcodes(path):
+    """Opcode names by value, from the Opcode enum."""
+    with open(path) as f:
+        source = f.read()
+    body = re.search(r"enum class Opcode[^{]*\{(.*?)\};", source, re.S).group(1)
+    body = re.sub(r"//.*", "", body)
+    return [name.strip() for name in body.split(",") if name.strip()]
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class TraceDecoder:
+    def __init__(self, events, opcodes, out):
+        self.events = events
+        self.opcodes = opcodes
+        self.out = out
+        self.text = bytearray()
+        self.record = None  # bytes of the record being read, None between records
+        self.expected = None
+        self.lost = 0
+        self.bad = 0
+
+    def feed(self, data):
+        for byte in data:
+            if self.record is not None:
+                if byte == 0:
+                    self.finish_record(bytes(self.record))
+                    self.record = None
+                else:
+                    self.record.append(byte)
+            elif byte == 0:
+                # a record starts; text printed so far without a newline is shown as is.
+                self.flush_text()
+                self.record = bytearray()
+            elif byte == 0x0A:
+                self.flush_text()
+            elif byte != 0x0D:
+                self.text.append(byte)
+
+    def flush_text(self):
+        if self.text:
+            self.out.write(self.text.decode("latin-1") + "\n")
+            self.text = bytearray()
+
+    def finish_record(self, encoded):
+        if not encoded:
+            return
+        raw = cobs_decode(encoded)
+        if raw is None or len(raw) < HEADER_SIZE + 2 or crc16(raw[:-2]) != raw[-2] | raw[-1] << 8:
+            self.bad += 1
+            self.out.write("[corrupt trace record]\n")
+            return
+        if raw[1] != FRAME_TYPE_TRACE:
+            return
+        sequence = raw[3] | raw[4] << 8
+        if self.expected is not None and sequence != self.expected:
+            if sequence == 0:
+                self.out.write("[Mega restarted]\n")
+            else:
+                missing = (sequence - self.expected) & 0xFFFF
+                self.lost += missing
+                self.out.write("[%d trace record(s) lost]\n" % missing)
+        self.expected = (sequence + 1) & 0xFFFF
+        self.out.write(self.format(raw[HEADER_SIZE:-2]) + "\n")
+
+    def format(self, payload):
+        if len(payload) < 5:
+            return "[short trace record]"
+        event = payload[0]
+        millis = int.from_bytes(payload[1:5], "little")
+        if event >= len(self.events):
+            return "%10.3f [unknown event %d: %s]" % (millis / 1000.0, event, payload[5:].hex())
+        text = self.events[event]
+        arguments = payload[5:]
+        position = 0
+        pieces = []
+        last = 0
+        for match in PLACEHOLDER.finditer(text):
+            kind = match.group(1)
+            size = 1 if kind == "op" else SIZES[kind[1:]]
+            value = int.from_bytes(arguments[position:position + size], "little", signed=kind[0] == "i")
+            position += size
+            if kind == "op":
+                shown = self.opcodes[value] if value < len(self.opcodes) else str(value)
+            elif kind[0] == "x":
+                shown = "%0*X" % (size * 2, value)
+            else:
+                shown = str(value)
+            pieces.append(text[last:match.start()] + shown)
+            last = match.end()
+        pieces.append(text[last:])
+        line = "".join(pieces)
+        if position != len(arguments):
+            line += " [argument size mismatch, is MegaTrace.h out of date?]"
+        return "%10.3f %s" % (millis / 1000.0, line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the Mega's binary trace log.")
+    parser.add_argument("input", nargs="?", default="-", help="captured console output, - for stdin")
+    parser.add_argument("--port", help="read the console from this serial port instead")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--events", default=TRACE_HEADER, help="MegaTrace.h to take the event texts from")
+    args = parser.parse_args()
+
+    decoder = TraceDecoder(load_events(args.events), load_opcodes(COMMANDS_HEADER), sys.stdout)
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            try:
+                while True:
+                    decoder.feed(port.read(256))
+                    sys.stdout.flush()
+            except KeyboardInterrupt:
+                pass
+    else:
+        stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+        with stream:
+            while True:
+                chunk = stream.read(4096)
+                if not chunk:
+                    break
+                decoder.feed(chunk)
+    decoder.flush_text()
+    if decoder.lost or decoder.bad:
+        sys.stderr.write("%d record(s) lost, %d corrupt\n" % (decoder.lost, decoder.bad))
+
+
+if __name__ == "__main__":
+    main()